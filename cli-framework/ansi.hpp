@@ -234,4 +234,28 @@ namespace cli
 	{
 		return "\0338";
 	}
+
+	// reports mouse presses, releases, wheel and motion as SGR sequences. see cli::Input for decoding them
+	inline std::string enable_mouse()
+	{
+		return "\033[?1000h\033[?1002h\033[?1006h";
+	}
+
+	// stops mouse reporting
+	inline std::string disable_mouse()
+	{
+		return "\033[?1006l\033[?1002l\033[?1000l";
+	}
+
+	// makes the terminal wrap pasted text in markers so it can be told apart from typed text
+	inline std::string enable_bracketed_paste()
+	{
+		return "\033[?2004h";
+	}
+
+	// stops wrapping pasted text
+	inline std::string disable_bracketed_paste()
+	{
+		return "\033[?2004l";
+	}
 }
\ No newline at end of file
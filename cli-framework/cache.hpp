@@ -0,0 +1,181 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+
+namespace cli
+{
+	// a size bounded LRU cache of command output with a time to live per entry.
+	// keys are spread over shards that each have their own lock so lookups from many threads rarely wait on each other.
+	// an optional second tier, e.g. a cli::DiskCache, is asked on a miss and told about every new entry
+	class ResultCache
+	{
+	public:
+
+        using Value = std::shared_ptr<const std::string>;
+        using LoadFN = std::function<bool(const std::string& key, std::string& value, std::chrono::milliseconds& ttl)>;
+        using StoreFN = std::function<void(const std::string& key, std::string_view value, std::chrono::milliseconds ttl)>;
+
+        explicit ResultCache(size_t max_bytes = 64 * 1024 * 1024, size_t shard_count = 16)
+            :
+                shard_bytes(std::max<size_t>(1, max_bytes / std::max<size_t>(1, shard_count))),
+                shards(std::max<size_t>(1, shard_count))
+        {
+            for (auto &shard : shards)
+                shard = std::make_unique<Shard>();
+        }
+
+        ResultCache(const ResultCache&) = delete;
+        ResultCache& operator=(const ResultCache&) = delete;
+
+        // returns the cached output or a nullptr if there is none or it expired
+        Value get(const std::string& key)
+        {
+            using namespace std::chrono;
+
+            Shard &shard = shard_for(key);
+
+            {
+                std::lock_guard lock(shard.mtx);
+
+                auto it = shard.index.find(key);
+
+                if (it != shard.index.end())
+                {
+                    if (it->second->expires > steady_clock::now())
+                    {
+                        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+                        return it->second->value;
+                    }
+
+                    erase(shard, it->second);
+                }
+            }
+
+            std::string value;
+            milliseconds ttl{};
+
+            if (!load || !load(key, value, ttl))
+                return nullptr;
+
+            auto shared = std::make_shared<const std::string>(std::move(value));
+            insert(key, shared, ttl);
+
+            return shared;
+        }
+
+        void put(const std::string& key, std::string value, std::chrono::milliseconds ttl)
+        {
+            auto shared = std::make_shared<const std::string>(std::move(value));
+
+            insert(key, shared, ttl);
+
+            if (store)
+                store(key, *shared, ttl);
+        }
+
+        void clear()
+        {
+            for (auto &shard : shards)
+            {
+                std::lock_guard lock(shard->mtx);
+
+                shard->index.clear();
+                shard->lru.clear();
+                shard->bytes = 0;
+            }
+        }
+
+        // builds a key from a command name and its arguments. every part is length prefixed so no two calls share a key
+        static std::string make_key(std::string_view name, const std::vector<std::string>& args)
+        {
+            std::string key;
+
+            auto append = [&key](std::string_view part)
+            {
+                key += std::to_string(part.size());
+                key += ':';
+                key += part;
+            };
+
+            append(name);
+
+            for (const auto &arg : args)
+                append(arg);
+
+            return key;
+        }
+
+        // the second tier, both are optional
+        LoadFN load;
+        StoreFN store;
+
+	private:
+
+        struct Entry
+        {
+            std::string key;
+            Value value;
+            std::chrono::steady_clock::time_point expires;
+        };
+
+        struct Shard
+        {
+            std::mutex mtx;
+            std::list<Entry> lru;
+            std::unordered_map<std::string_view, std::list<Entry>::iterator> index;
+            size_t bytes = 0;
+        };
+
+        size_t shard_bytes;
+        std::vector<std::unique_ptr<Shard>> shards;
+
+        Shard& shard_for(std::string_view key)
+        {
+            return *shards[std::hash<std::string_view>{}(key) % shards.size()];
+        }
+
+        static size_t cost(const Entry& e)
+        {
+            return e.key.size() + e.value->size();
+        }
+
+        void insert(const std::string& key, Value value, std::chrono::milliseconds ttl)
+        {
+            using namespace std::chrono;
+
+            Shard &shard = shard_for(key);
+
+            std::lock_guard lock(shard.mtx);
+
+            if (auto it = shard.index.find(key); it != shard.index.end())
+                erase(shard, it->second);
+
+            shard.lru.push_front(Entry{ key, std::move(value), steady_clock::now() + ttl });
+
+            auto entry = shard.lru.begin();
+
+            shard.index.emplace(entry->key, entry);
+            shard.bytes += cost(*entry);
+
+            // the newest entry always stays even if it alone is over the limit
+            while (shard.bytes > shard_bytes && shard.lru.size() > 1)
+                erase(shard, std::prev(shard.lru.end()));
+        }
+
+        static void erase(Shard& shard, std::list<Entry>::iterator entry)
+        {
+            shard.bytes -= cost(*entry);
+            shard.index.erase(entry->key);
+            shard.lru.erase(entry);
+        }
+	};
+}
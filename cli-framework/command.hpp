@@ -8,15 +8,36 @@
 #include <initializer_list>
 #include <functional>
 #include <ostream>
+#include <sstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <algorithm>
+#include <memory>
+#include <iostream>
+#include "cache.hpp"
+#include "flags.hpp"
+#include "trie.hpp"
 
 namespace cli
 {
+	class Pipe;
+
 	class CommandHandler
     {
     public:
 
+        struct Command;
+
         using Args = std::vector<std::string>;
         using ExecFN = std::function<void(Args)>;
+        using WriteFN = std::function<void(Args, std::ostream&)>;
+        using CooldownFN = std::function<bool(std::string_view, std::chrono::milliseconds)>;
+        using PipeFN = std::function<void(Args, Pipe& in, Pipe& out)>;
+        using LoadFN = std::function<bool(Command&)>;
 
         struct Command
         {
@@ -24,6 +45,31 @@ namespace cli
             std::string_view description;
             size_t cooldown;
             ExecFN exec;
+            // optional variant of exec that writes to the given stream instead of std::cout.
+            // commands that set it can have their output captured, e.g. by fan_out
+            WriteFN write{};
+            // caches the captured output of write for this many ms per set of arguments, 0 disables it.
+            // only for pure commands whose output depends on nothing but their arguments. needs CommandHandler::cache
+            size_t cache_ttl = 0;
+            // optional stream filter used when the command is a stage of a pipeline, see cli::pipeline.
+            // it reads the previous stage from in and writes to out
+            PipeFN pipe{};
+            // optional, called by lookup before the command is used with the command itself so it can fill in its implementation,
+            // e.g. a plugin whose shared object is only opened on first use. returns false if that failed and the command then fails
+            LoadFN load{};
+            // flags of this command, bound while run walks the arguments so every level of a subcommand path has its own
+            Flags flags{};
+            // the commands one level below this one, e.g. "add" in "tool remote add". see sub
+            std::shared_ptr<CommandHandler> children{};
+
+            // returns the level below this command, creating it on first use
+            CommandHandler& sub()
+            {
+                if (!children)
+                    children = std::make_shared<CommandHandler>();
+
+                return *children;
+            }
         };
 
         struct Cooldown
@@ -38,74 +84,542 @@ namespace cli
             bool ok;
         };
 
+        struct FanOut
+        {
+            size_t threads = 0;     // worker count, 0 uses the hardware concurrency
+            bool ordered   = true;  // emit output in input order, otherwise in completion order
+        };
+
         std::map<std::string_view, Command> cmds;
 
+        // when set it decides cooldowns instead of the in process map, e.g. a cli::SharedCooldowns shared by every invocation.
+        // it gets the command name and its cooldown and returns false if the command is still on cooldown
+        CooldownFN cooldown_backend;
+
+        // shared by every command with a cache_ttl, cache hits replay the output without calling the command
+        std::shared_ptr<ResultCache> cache;
+
         CommandHandler(std::initializer_list<std::pair<const std::string_view, Command>> commands)
                 : cmds(commands)
         {}
 
         CommandHandler() = default;
 
+        // for commands with subcommands or flags args is left with the arguments the command got, see lookup
         Result run(std::string_view name, Args& args)
         {
+            std::string path;
+            Result result;
+            Args given = cache ? args : Args{};
+
+            Command *cmd = acquire(name, args, path, result);
 
-            std::string_view cmd_name;
+            if (!cmd)
+                return result;
 
-            if (cmds.contains(name))
-                cmd_name = name;
+            if (cacheable(*cmd))
+                invoke(path, *cmd, args, std::cout, given);
+            else if (cmd->exec)
+                cmd->exec(args);
             else
+                cmd->write(args, std::cout);
+
+            return {nullptr, true};
+        }
+
+        // same as run but the output of commands that implement write goes to os
+        Result run(std::string_view name, Args& args, std::ostream& os)
+        {
+            std::string path;
+            Result result;
+            Args given = cache ? args : Args{};
+
+            Command *cmd = acquire(name, args, path, result);
+
+            if (!cmd)
+                return result;
+
+            invoke(path, *cmd, args, os, given);
+
+            return {nullptr, true};
+        }
+
+        // returns the command with this name or alias on this level, or a nullptr
+        Command* find(std::string_view name)
+        {
+            std::string_view key = resolve(name);
+
+            return key.empty() ? nullptr : &cmds[key];
+        }
+
+        // finds the command for name and walks args down its subcommands, e.g. "remote add -f origin url".
+        // words are matched against the level below through a trie until the first positional argument and
+        // every flag is bound by the innermost level that knows it, all in one pass over args.
+        // args is left with the positional arguments and unknown flags, "--" ends flag parsing.
+        // path is set to the names of the matched commands, e.g. "remote add", which is what cooldowns and the cache use.
+        // the flags of every matched level are set back to their defaults first so nothing carries over from an earlier run,
+        // and matched commands with a load function are loaded before anything of them is used.
+        // commands without subcommands or flags keep args as they are. returns a nullptr and sets result if there is no command
+        Command* lookup(std::string_view name, Args& args, std::string& path, Result& result)
+        {
+            std::string_view key = resolve(name);
+
+            if (key.empty())
             {
-                std::string_view alias = find_by_alias(name);
+                result = {"command not found", false};
+                return nullptr;
+            }
+
+            Command *cmd = &cmds[key];
+            path = key;
+            result = {nullptr, true};
+
+            if (cmd->load && !cmd->load(*cmd))
+            {
+                result = {"failed to load plugin", false};
+                return nullptr;
+            }
+
+            if (!cmd->children && cmd->flags.flags.empty())
+                return cmd;
+
+            cmd->flags.restore();
+
+            std::vector<const char*> argv;
+            argv.reserve(args.size());
+
+            for (const auto &arg : args)
+                argv.push_back(arg.c_str());
+
+            std::vector<Command*> levels = { cmd };
+            Args rest;
+            bool positional = false;
+            bool flags_done = false;
+            int argc = (int)argv.size();
+
+            for (int i = 0; i < argc;)
+            {
+                std::string_view arg = argv[i];
+
+                if (!flags_done && arg == "--")
+                {
+                    flags_done = true;
+                    positional = true;
+                    i++;
+                    continue;
+                }
+
+                if (!flags_done && arg.size() > 1 && arg[0] == '-')
+                {
+                    int used = 0;
+
+                    for (auto it = levels.rbegin(); it != levels.rend() && used == 0; ++it)
+                        used = (*it)->flags.consume(i, argc, argv.data());
+
+                    // unknown flags are passed on as arguments but do not end the subcommand path
+                    if (used == 0)
+                    {
+                        rest.push_back(args[i]);
+                        used = 1;
+                    }
+
+                    i += used;
+                    continue;
+                }
+
+                if (!positional && cmd->children)
+                {
+                    if (std::string_view child = cmd->children->resolve(arg); !child.empty())
+                    {
+                        cmd = &cmd->children->cmds[child];
+
+                        if (cmd->load && !cmd->load(*cmd))
+                        {
+                            result = {"failed to load plugin", false};
+                            return nullptr;
+                        }
+
+                        cmd->flags.restore();
+                        levels.push_back(cmd);
+
+                        path += ' ';
+                        path += child;
+
+                        i++;
+                        continue;
+                    }
+                }
+
+                positional = true;
+                rest.push_back(args[i]);
+                i++;
+            }
+
+            args = std::move(rest);
+
+            if (!cmd->exec && !cmd->write && !cmd->pipe)
+            {
+                result = {"missing subcommand", false};
+                return nullptr;
+            }
+
+            return cmd;
+        }
+
+        // looks up a command like lookup and applies its cooldown without running it.
+        // returns a nullptr and sets result if it can not run, which includes commands that only implement pipe.
+        // used to run commands outside of run
+        Command* acquire(std::string_view name, Args& args, std::string& path, Result& result)
+        {
+            Command *cmd = lookup(name, args, path, result);
+
+            if (!cmd)
+                return nullptr;
+
+            if (!cmd->exec && !cmd->write)
+            {
+                result = {cmd->pipe ? "command can only be used in a pipeline" : "command has nothing to run", false};
+                return nullptr;
+            }
+
+            if(!start_cooldown(path, *cmd))
+            {
+                result = {"command is on cooldown", false};
+                return nullptr;
+            }
+
+            return cmd;
+        }
+
+        // applies the cooldown of a command found through lookup, false if it is still on cooldown
+        bool start_cooldown(std::string_view path, Command& cmd)
+        {
+            return manage_cooldown(path, cmd);
+        }
+
+        // applies the cooldowns of several commands found through lookup at once, e.g. the stages of cli::pipeline.
+        // a path that is listed more than once counts once and nothing starts unless every cooldown is over.
+        // a cooldown_backend can only be asked by using it, so with one the commands before one that is on cooldown still count
+        bool start_cooldowns(const std::vector<std::pair<std::string_view, Command*>>& commands)
+        {
+            std::vector<std::pair<std::string_view, Command*>> unique;
+
+            for (const auto &entry : commands)
+            {
+                if (std::none_of(unique.begin(), unique.end(), [&](const auto& u) { return u.first == entry.first; }))
+                    unique.push_back(entry);
+            }
+
+            if (!cooldown_backend)
+            {
+                for (const auto &[path, cmd] : unique)
+                {
+                    if (on_cooldown(path, *cmd))
+                        return false;
+                }
+            }
+
+            for (const auto &[path, cmd] : unique)
+            {
+                if (!manage_cooldown(path, *cmd))
+                    return false;
+            }
+
+            return true;
+        }
 
-                if (!cmds.contains(alias))
-                    return {"command not found", false};
+        // runs the command once per input on a pool of threads, like xargs -P.
+        // name can be a whole subcommand path like "remote add", words left over after it go in front of every input.
+        // each task writes into its own buffer which is emitted to os as a whole so output never interleaves,
+        // which needs write since exec only commands print straight to std::cout.
+        // the cooldown applies to the fan out as a whole and not to every task.
+        // if a task throws the remaining tasks still run and the first exception is rethrown at the end
+        template<typename Out>
+        Result fan_out(std::string_view name, const std::vector<Args>& inputs, Out& os)
+        {
+            return fan_out(name, inputs, os, FanOut{});
+        }
+
+        template<typename Out>
+        Result fan_out(std::string_view name, const std::vector<Args>& inputs, Out& os, FanOut opts)
+        {
+            Args prefix;
+
+            for (size_t start = 0, end; start < name.size(); start = end + 1)
+            {
+                end = std::min(name.find(' ', start), name.size());
 
-                cmd_name = alias;
+                if (end > start)
+                    prefix.emplace_back(name.substr(start, end - start));
             }
 
-            Command &cmd = cmds[cmd_name];
+            if (prefix.empty())
+                return {"command not found", false};
+
+            std::string first = std::move(prefix[0]);
+            prefix.erase(prefix.begin());
+
+            Args given = cache ? prefix : Args{};
+
+            std::string path;
+            Result result;
+
+            Command *found = lookup(first, prefix, path, result);
+
+            if (!found)
+                return result;
+
+            Command &cmd = *found;
 
-            if(!manage_cooldown(cmd_name, cmd))
+            if (!cmd.write)
+                return {"command does not support fan_out", false};
+
+            if(!manage_cooldown(path, cmd))
                 return {"command is on cooldown", false};
 
-            cmd.exec(args);
+            if (inputs.empty())
+                return {nullptr, true};
+
+            size_t threads = opts.threads;
+
+            if (threads == 0)
+                threads = std::max(1u, std::thread::hardware_concurrency());
+
+            threads = std::min(threads, inputs.size());
+
+            std::vector<std::string> buffers(inputs.size());
+            std::vector<bool> done(inputs.size());
+            std::deque<size_t> finished;
+            std::exception_ptr error;
+
+            std::atomic<size_t> next = 0;
+            std::mutex mtx;
+            std::condition_variable cv;
+
+            auto worker = [&]
+            {
+                for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < inputs.size();)
+                {
+                    std::ostringstream buff;
+                    std::exception_ptr e;
+
+                    try
+                    {
+                        if (prefix.empty() && given.empty())
+                            invoke(path, cmd, inputs[i], buff, inputs[i]);
+                        else
+                        {
+                            Args args = prefix;
+                            args.insert(args.end(), inputs[i].begin(), inputs[i].end());
+
+                            Args words = given;
+                            words.insert(words.end(), inputs[i].begin(), inputs[i].end());
+
+                            invoke(path, cmd, args, buff, words);
+                        }
+                    }
+                    catch (...)
+                    {
+                        e = std::current_exception();
+                    }
+
+                    {
+                        std::lock_guard lock(mtx);
+
+                        buffers[i] = std::move(buff).str();
+                        done[i] = true;
+                        finished.push_back(i);
+
+                        if (e && !error)
+                            error = e;
+                    }
+
+                    cv.notify_one();
+                }
+            };
+
+            std::vector<std::thread> pool;
+            pool.reserve(threads);
+
+            for (size_t i = 0; i < threads; i++)
+                pool.emplace_back(worker);
+
+            // the calling thread emits buffers as soon as they are ready so output streams while the pool works
+            for (size_t emitted = 0; emitted < inputs.size(); emitted++)
+            {
+                std::string out;
+
+                {
+                    std::unique_lock lock(mtx);
+
+                    size_t i = emitted;
+
+                    if (opts.ordered)
+                        cv.wait(lock, [&] { return done[i]; });
+                    else
+                    {
+                        cv.wait(lock, [&] { return !finished.empty(); });
+                        i = finished.front();
+                        finished.pop_front();
+                    }
+
+                    out = std::move(buffers[i]);
+                }
+
+                os.write(out.data(), (std::streamsize)out.size());
+            }
+
+            for (auto &t : pool)
+                t.join();
+
+            if (error)
+                std::rethrow_exception(error);
 
             return {nullptr, true};
         }
 
-        void help(std::ostream &os)
+        // works with any stream like target, e.g. std::ostream or cli::Output. subcommands are listed by their full path
+        template<typename Out>
+        void help(Out &os)
+        {
+            help(os, "");
+        }
+
+    private:
+        std::map<std::string, Cooldown, std::less<>> cooldowns;
+
+        // every name and alias of this level mapped to the key of its command, built on demand
+        Trie<std::string> index;
+
+        template<typename Out>
+        void help(Out &os, const std::string& prefix)
         {
             for (auto&[k, v]: cmds)
             {
-                os << k << ": " << v.description << '\n';
+                std::string path = prefix + std::string(k);
+
+                os << path << ": " << v.description << '\n';
+
+                if (v.children)
+                    v.children->help(os, path + ' ');
             }
         }
 
-    private:
-        std::map<std::string_view, Cooldown> cooldowns;
+        // returns the key of the command by name or alias, empty if it does not exist.
+        // cmds can change at any time so a hit in the index is checked against it, and a miss falls back to a scan
+        // that rebuilds the index when it finds what the index did not
+        std::string_view resolve(std::string_view name)
+        {
+            if (const std::string *key = index.find(name))
+            {
+                auto it = cmds.find(*key);
+
+                if (it != cmds.end() && (it->first == name || std::find(it->second.alias.begin(), it->second.alias.end(), name) != it->second.alias.end()))
+                    return it->first;
+            }
+
+            std::string_view key;
+
+            if (auto it = cmds.find(name); it != cmds.end())
+                key = it->first;
+            else
+                key = find_by_alias(name);
+
+            if (key.empty())
+                return {};
+
+            index.clear();
+
+            for (auto& [k, v] : cmds)
+            {
+                index.insert(k, std::string(k));
+
+                for (auto &a : v.alias)
+                    index.insert(a, std::string(k));
+            }
+
+            return key;
+        }
+
+        bool cacheable(const Command& cmd) const
+        {
+            return cache && cmd.cache_ttl > 0 && cmd.write;
+        }
+
+        // given are the arguments before lookup bound the flags, the cache key is built from them so runs with
+        // different flags never share an entry
+        void invoke(std::string_view cmd_name, Command& cmd, const Args& args, std::ostream& os, const Args& given)
+        {
+            if (!cacheable(cmd))
+            {
+                if (cmd.write)
+                    cmd.write(args, os);
+                else
+                    cmd.exec(args);
+
+                return;
+            }
+
+            std::string key = ResultCache::make_key(cmd_name, given);
+
+            if (auto hit = cache->get(key))
+            {
+                os.write(hit->data(), (std::streamsize)hit->size());
+                return;
+            }
+
+            std::ostringstream buff;
+            cmd.write(args, buff);
+
+            std::string out = std::move(buff).str();
+            os.write(out.data(), (std::streamsize)out.size());
+
+            cache->put(key, std::move(out), std::chrono::milliseconds(cmd.cache_ttl));
+        }
+
+        // checks the in process cooldown without starting it
+        bool on_cooldown(std::string_view cmd_name, const Command& cmd) const
+        {
+            using namespace std::chrono;
+
+            if (cmd.cooldown == 0)
+                return false;
+
+            auto it = cooldowns.find(cmd_name);
+
+            return it != cooldowns.end() && duration_cast<milliseconds>(system_clock::now() - it->second.time) <= it->second.amount;
+        }
 
         bool manage_cooldown(std::string_view cmd_name, Command& cmd)
         {
             using namespace std::chrono;
 
-            if (!cooldowns.contains(cmd_name))
+            if (cmd.cooldown == 0)
+                return true;
+
+            if (cooldown_backend)
+                return cooldown_backend(cmd_name, milliseconds(cmd.cooldown));
+
+            auto it = cooldowns.find(cmd_name);
+
+            if (it == cooldowns.end())
             {
-                cooldowns[cmd_name] = Cooldown
+                cooldowns.emplace(cmd_name, Cooldown
                 {
                     .amount =  milliseconds(cmd.cooldown),
                     .time   = system_clock::now()
-                };
+                });
             }
             else
             {
-                auto &cooldown  = cooldowns[cmd_name];
+                auto &cooldown  = it->second;
                 auto now        = system_clock::now();
                 auto diff       = duration_cast<milliseconds>(now - cooldown.time);
 
                 if (diff <= cooldown.amount)
                     return false;
                 else
-                    cooldowns.erase(cmd_name);
+                    cooldowns.erase(it);
             }
 
             return true;
@@ -115,9 +629,6 @@ namespace cli
 		{
 			for (auto& [k, v] : cmds)
 			{
-				if (v.alias.empty())
-					return {};
-
 				for (auto &a : v.alias)
 				{
 					if (a == alias)
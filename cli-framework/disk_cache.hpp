@@ -0,0 +1,236 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <thread>
+#include <functional>
+#include <filesystem>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "cache.hpp"
+
+namespace cli
+{
+	// an on disk tier for ResultCache so separate invocations share results.
+	// every entry is a file named after the hash of its key, read with a single pread into the value the cache keeps.
+	// entries are written to a temporary file and renamed into place so readers never see a partial entry.
+	// expired entries are only removed by prune, which makes sure it never removes one that was just replaced
+	class DiskCache
+	{
+	public:
+
+        explicit DiskCache(std::string dir)
+            : dir(std::move(dir))
+        {
+            std::error_code ec;
+            std::filesystem::create_directories(this->dir, ec);
+        }
+
+        // makes the cache ask this tier on a miss and write every new entry through to it
+        void attach(ResultCache& cache)
+        {
+            cache.load = [this](const std::string& key, std::string& value, std::chrono::milliseconds& ttl)
+            {
+                return load(key, value, ttl);
+            };
+
+            cache.store = [this](const std::string& key, std::string_view value, std::chrono::milliseconds ttl)
+            {
+                store(key, value, ttl);
+            };
+        }
+
+        bool load(const std::string& key, std::string& value, std::chrono::milliseconds& ttl)
+        {
+            std::string path = path_for(key);
+
+            int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+            if (fd < 0)
+                return false;
+
+            struct stat st{};
+            bool found = false;
+
+            if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(Header))
+            {
+                std::string data((size_t)st.st_size, '\0');
+
+                if (read_all(fd, data.data(), data.size()))
+                {
+                    Header header;
+                    std::memcpy(&header, data.data(), sizeof(header));
+
+                    int64_t now = now_ms();
+
+                    bool valid = header.magic == magic &&
+                                 sizeof(Header) + header.key_size + header.value_size == data.size() &&
+                                 std::string_view(data).substr(sizeof(Header), header.key_size) == key;
+
+                    if (valid && header.expires > now)
+                    {
+                        // the value reuses the buffer the file was read into instead of a second allocation
+                        data.erase(0, sizeof(Header) + header.key_size);
+                        value = std::move(data);
+
+                        ttl = std::chrono::milliseconds(header.expires - now);
+                        found = true;
+                    }
+                }
+            }
+
+            close(fd);
+
+            return found;
+        }
+
+        void store(const std::string& key, std::string_view value, std::chrono::milliseconds ttl)
+        {
+            std::string path = path_for(key);
+            std::string tmp = path + ".tmp." + std::to_string(getpid()) + "." +
+                              std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+
+            int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+
+            if (fd < 0)
+                return;
+
+            Header header{ magic, now_ms() + ttl.count(), key.size(), value.size() };
+
+            bool ok = write_all(fd, &header, sizeof(header)) &&
+                      write_all(fd, key.data(), key.size()) &&
+                      write_all(fd, value.data(), value.size());
+
+            close(fd);
+
+            if (!ok || rename(tmp.c_str(), path.c_str()) != 0)
+                unlink(tmp.c_str());
+        }
+
+        // removes expired entries and temporary files left behind by processes that died while writing
+        void prune()
+        {
+            std::error_code ec;
+
+            for (const auto &file : std::filesystem::directory_iterator(dir, ec))
+            {
+                std::string path = file.path().string();
+
+                if (path.find(".tmp.") != std::string::npos)
+                {
+                    auto age = std::filesystem::file_time_type::clock::now() - file.last_write_time(ec);
+
+                    if (!ec && age > std::chrono::minutes(1))
+                        std::filesystem::remove(file.path(), ec);
+
+                    continue;
+                }
+
+                int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+                if (fd < 0)
+                    continue;
+
+                Header header{};
+                struct stat st{};
+
+                bool expired = pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) &&
+                               header.magic == magic && header.expires <= now_ms() && fstat(fd, &st) == 0;
+
+                close(fd);
+
+                // another process may have renamed a fresh entry into place since, only the file that was read goes
+                struct stat now{};
+
+                if (expired && stat(path.c_str(), &now) == 0 && now.st_ino == st.st_ino && now.st_dev == st.st_dev)
+                    unlink(path.c_str());
+            }
+        }
+
+	private:
+
+        static constexpr uint64_t magic = 0x434c494341434845; // CLICACHE
+
+        struct Header
+        {
+            uint64_t magic;
+            int64_t expires;    // ms since the unix epoch so every process agrees on it
+            uint64_t key_size;
+            uint64_t value_size;
+        };
+
+        std::string dir;
+
+        static int64_t now_ms()
+        {
+            using namespace std::chrono;
+            return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+        }
+
+        std::string path_for(const std::string& key) const
+        {
+            // FNV-1a, stable across processes unlike std::hash. collisions are caught by comparing the stored key
+            uint64_t hash = 0xcbf29ce484222325;
+
+            for (char c : key)
+            {
+                hash ^= (unsigned char)c;
+                hash *= 0x100000001b3;
+            }
+
+            char name[17];
+            snprintf(name, sizeof(name), "%016llx", (unsigned long long)hash);
+
+            return dir + "/" + name;
+        }
+
+        static bool read_all(int fd, char* data, size_t size)
+        {
+            size_t done = 0;
+
+            while (done < size)
+            {
+                ssize_t n = pread(fd, data + done, size - done, (off_t)done);
+
+                if (n < 0 && errno == EINTR)
+                    continue;
+
+                if (n <= 0)
+                    return false;
+
+                done += n;
+            }
+
+            return true;
+        }
+
+        static bool write_all(int fd, const void* data, size_t size)
+        {
+            const char *p = (const char*)data;
+
+            while (size > 0)
+            {
+                ssize_t n = ::write(fd, p, size);
+
+                if (n < 0)
+                {
+                    if (errno == EINTR)
+                        continue;
+
+                    return false;
+                }
+
+                p += n;
+                size -= n;
+            }
+
+            return true;
+        }
+	};
+}
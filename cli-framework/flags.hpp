@@ -4,7 +4,9 @@
 #include <string>
 #include <map>
 #include <ostream>
+#include <iostream>
 #include <string_view>
+#include <functional>
 
 namespace cli
 {
@@ -26,16 +28,23 @@ namespace cli
             void*		buff;
             Type	    type;
             const char*	description;
+            // writes back the value the variable had when the flag was set
+            std::function<void()> restore;
         };
 
 		Flags(int count, const char* argv[], bool auto_help = false, const char* help_keyword = "help")
 			:
-                auto_help(auto_help),
                 argc(count),
                 argv(argv),
+                auto_help(auto_help),
                 help_keyword(std::move(std::string("-")+help_keyword))
 		{}
 
+		// flags that are not bound to the program arguments, they can only be parsed through consume
+		Flags()
+			: Flags(0, nullptr)
+		{}
+
 		Flags& set(bool& buff, const std::string& name, const char* description)
 		{
 			add_flag(Type::BOOL, buff, name, description);
@@ -98,32 +107,58 @@ namespace cli
 					continue;
 				}
 
-				FlagData flag = flags[flag_name];
+                // the value of a flag given as "-flag value" is the next argument which is skipped
+                skip_next = consume(i, argc, argv) == 2;
+			}
+		}
+
+        // parses args[i] if it is one of the set flags and returns how many arguments it used, 0 if it is not a flag.
+        // lets flags be bound one argument at a time, e.g. by CommandHandler where every level of a subcommand path has its own
+        int consume(int i, int count, const char* args[])
+        {
+            auto [p_flag, p_value] = get_equal(args[i]);
 
-                if(flag.type == Type::BOOL)
-                {
-                    *(bool*)flag.buff = true;
-                    continue;
-                }
+            bool has_equal = !p_flag.empty();
 
-                std::string value;
+            auto it = flags.find(has_equal ? p_flag : std::string(args[i]));
 
-                if(has_equal)
-                    value = std::move(p_value);
-                else
-                {
-                    if(i+1 == argc)
-                        return;
-                    value = argv[i+1];
-                    skip_next = true;
-                }
+            if (it == flags.end())
+                return 0;
 
-				parse_type(flag.type, flag.buff, value);
-			}
-		}
+            const FlagData &flag = it->second;
+
+            if(flag.type == Type::BOOL)
+            {
+                *(bool*)flag.buff = true;
+                return 1;
+            }
+
+            if(has_equal)
+            {
+                parse_type(flag.type, flag.buff, p_value);
+                return 1;
+            }
+
+            if(i+1 == count)
+                return 1;
+
+            std::string value = args[i+1];
+            parse_type(flag.type, flag.buff, value);
+
+            return 2;
+        }
+
+        // sets every flag back to its default, the value its variable had when the flag was set.
+        // flags bound through consume stay set otherwise, so a later parse would still see the flags of an earlier one
+        void restore()
+        {
+            for (auto& [name, data] : flags)
+                data.restore();
+        }
 
-        // outputs a help message to your ostream of choice
-        void help(std::ostream& os)
+        // outputs a help message to your ostream of choice or a cli::Output
+        template<typename Out>
+        void help(Out& os)
         {
             os << "\nUsage:\n -flag=value, -flag value, -flag\n\n";
 
@@ -191,6 +226,7 @@ namespace cli
 				&buff,
 				t,
 				description,
+				[&buff, initial = buff] { buff = initial; }
 			};
 
 			std::string flag_name = "-";
@@ -210,6 +246,7 @@ namespace cli
                     case Type::STRING:	*(std::string*)buff     = value;					break;
                     case Type::FLOAT:   *(float*)buff		    = std::stof(value);		    break;
                     case Type::BIG_INT: *(int64_t*)buff	        = std::stoll(value);		break;
+                    case Type::BOOL:                                                        break;
 				}
 			}
 			catch (...)
@@ -2,4 +2,19 @@
 
 #include "flags.hpp"
 #include "command.hpp"
-#include "ansi.hpp"
\ No newline at end of file
+#include "ansi.hpp"
+#include "trie.hpp"
+#include "tokenize.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include "output.hpp"
+#include "plugin.hpp"
+#include "shared_cooldown.hpp"
+#include "disk_cache.hpp"
+#endif
+
+#ifdef __linux__
+#include "input.hpp"
+#include "repl.hpp"
+#include "pipe.hpp"
+#endif
@@ -0,0 +1,654 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <optional>
+#include <deque>
+#include <vector>
+#include <chrono>
+#include <cerrno>
+#include <utility>
+#include <algorithm>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include "ansi.hpp"
+
+namespace cli
+{
+	enum class Key
+	{
+		character,
+		enter,
+		tab,
+		backspace,
+		escape,
+		up,
+		down,
+		left,
+		right,
+		home,
+		end,
+		insert,
+		del,
+		page_up,
+		page_down,
+		f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12,
+		mouse,
+		paste,
+		unknown
+	};
+
+	enum class Mouse
+	{
+		left,
+		middle,
+		right,
+		release,
+		wheel_up,
+		wheel_down
+	};
+
+	struct Event
+	{
+		Key key = Key::unknown;
+		char32_t ch = 0;        // the code point for Key::character. control keys come through as ctrl with their letter, or @ \ ] ^ _
+		bool ctrl   = false;
+		bool alt    = false;
+		bool shift  = false;
+
+		// only set for Key::mouse, coordinates start at 1 like the ansi cursor functions
+		Mouse button = Mouse::left;
+		bool motion  = false;
+		int row      = 0;
+		int column   = 0;
+
+		// the pasted text for Key::paste
+		std::string text;
+	};
+
+	// returns the terminal size as rows and columns, or 0 0 if fd is not a terminal
+	inline std::pair<int, int> terminal_size(int fd = STDOUT_FILENO)
+	{
+		winsize ws{};
+
+		if (ioctl(fd, TIOCGWINSZ, &ws) != 0)
+			return {0, 0};
+
+		return {ws.ws_row, ws.ws_col};
+	}
+
+	// puts the terminal into raw mode for as long as it lives and restores it afterwards.
+	// output processing is left on so '\n' still starts a new line
+	class Terminal
+	{
+	public:
+
+        explicit Terminal(bool mouse = false, bool bracketed_paste = false, int fd = STDIN_FILENO)
+            :
+                fd(fd),
+                mouse(mouse),
+                bracketed_paste(bracketed_paste)
+        {
+            if (tcgetattr(fd, &original) != 0)
+                return;
+
+            termios raw = original;
+
+            raw.c_iflag &= ~(BRKINT | ICRNL | INPCK | ISTRIP | IXON);
+            raw.c_cflag |= CS8;
+            raw.c_lflag &= ~(ECHO | ICANON | IEXTEN | ISIG);
+            raw.c_cc[VMIN]  = 1;
+            raw.c_cc[VTIME] = 0;
+
+            if (tcsetattr(fd, TCSADRAIN, &raw) != 0)
+                return;
+
+            active = true;
+
+            std::string modes;
+
+            if (mouse)
+                modes += enable_mouse();
+
+            if (bracketed_paste)
+                modes += enable_bracketed_paste();
+
+            put(modes);
+        }
+
+        Terminal(const Terminal&) = delete;
+        Terminal& operator=(const Terminal&) = delete;
+
+        ~Terminal()
+        {
+            if (!active)
+                return;
+
+            std::string modes;
+
+            if (mouse)
+                modes += disable_mouse();
+
+            if (bracketed_paste)
+                modes += disable_bracketed_paste();
+
+            put(modes);
+
+            tcsetattr(fd, TCSADRAIN, &original);
+        }
+
+        // false if fd is not a terminal
+        bool ok() const
+        {
+            return active;
+        }
+
+	private:
+		int fd;
+		bool mouse;
+		bool bracketed_paste;
+		bool active = false;
+		termios original{};
+
+        void put(const std::string& str)
+        {
+            if (!str.empty())
+                (void)::write(STDOUT_FILENO, str.data(), str.size());
+        }
+	};
+
+	// reads and decodes key, mouse and paste events from a file descriptor.
+	// it waits on epoll so it never sleeps or polls, a lone escape is told apart from the start of a sequence by
+	// waiting at most escape_timeout for the rest of it. a bracketed paste is waited on until it ends however long that takes.
+	// the descriptor is left in blocking mode, it is only read once epoll says there is something to read
+	class Input
+	{
+	public:
+
+        explicit Input(int fd = STDIN_FILENO, std::chrono::milliseconds escape_timeout = std::chrono::milliseconds(25))
+            :
+                fd(fd),
+                escape_timeout(escape_timeout)
+        {
+            epoll = epoll_create1(EPOLL_CLOEXEC);
+            wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+            epoll_event ev{};
+
+            ev.events = EPOLLIN;
+            ev.data.fd = fd;
+
+            // regular files cannot be watched by epoll but they never block either
+            pollable = epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &ev) == 0;
+
+            ev.data.fd = wake_fd;
+            epoll_ctl(epoll, EPOLL_CTL_ADD, wake_fd, &ev);
+        }
+
+        Input(const Input&) = delete;
+        Input& operator=(const Input&) = delete;
+
+        ~Input()
+        {
+            close(wake_fd);
+            close(epoll);
+        }
+
+        // waits for the next event. a negative timeout waits forever.
+        // returns nothing on timeout, when wake was called or when the input was closed, see closed()
+        std::optional<Event> next(int timeout_ms = -1)
+        {
+            using namespace std::chrono;
+
+            auto deadline = steady_clock::now() + milliseconds(timeout_ms);
+
+            while (events.empty())
+            {
+                if (eof)
+                {
+                    flush_pending();
+                    break;
+                }
+
+                if (!pollable)
+                {
+                    fill();
+                    decode();
+                    continue;
+                }
+
+                int wait = timeout_ms;
+
+                if (timeout_ms >= 0)
+                    wait = (int)std::max<long long>(0, duration_cast<milliseconds>(deadline - steady_clock::now()).count());
+
+                // an incomplete sequence only gets escape_timeout to finish before it is taken as typed.
+                // an open paste is the exception, its text can arrive in several reads with any delay in between
+                bool incomplete = !pending.empty() && !pasting();
+
+                if (incomplete && (wait < 0 || wait > escape_timeout.count()))
+                    wait = (int)escape_timeout.count();
+
+                epoll_event ev[2];
+                int n = epoll_wait(epoll, ev, 2, wait);
+
+                if (n < 0)
+                {
+                    if (errno == EINTR)
+                        continue;
+
+                    break;
+                }
+
+                if (n == 0)
+                {
+                    if (incomplete)
+                    {
+                        flush_pending();
+                        continue;
+                    }
+
+                    break;
+                }
+
+                bool woken = false;
+
+                for (int i = 0; i < n; i++)
+                {
+                    if (ev[i].data.fd == wake_fd)
+                    {
+                        uint64_t count;
+                        (void)::read(wake_fd, &count, sizeof(count));
+                        woken = true;
+                    }
+                    else
+                        fill();
+                }
+
+                decode();
+
+                if (woken && events.empty())
+                    break;
+            }
+
+            if (events.empty())
+                return std::nullopt;
+
+            Event e = std::move(events.front());
+            events.pop_front();
+
+            return e;
+        }
+
+        // makes a blocked next() return, safe to call from any thread or a signal handler
+        void wake()
+        {
+            uint64_t one = 1;
+            (void)::write(wake_fd, &one, sizeof(one));
+        }
+
+        // true once the input reached end of file
+        bool closed() const
+        {
+            return eof && events.empty() && pending.empty();
+        }
+
+	private:
+		int fd;
+		int epoll;
+		int wake_fd;
+		bool eof = false;
+		bool pollable;
+		std::chrono::milliseconds escape_timeout;
+
+		std::string pending;
+		std::deque<Event> events;
+
+        // reads what is available with a single read so it never blocks after epoll reported the descriptor readable
+        void fill()
+        {
+            int available = 0;
+
+            if (ioctl(fd, FIONREAD, &available) != 0 || available <= 0)
+                available = 4096;
+
+            size_t size = pending.size();
+            pending.resize(size + available);
+
+            ssize_t n;
+
+            do
+                n = ::read(fd, pending.data() + size, available);
+            while (n < 0 && errno == EINTR);
+
+            pending.resize(size + std::max<ssize_t>(n, 0));
+
+            if (n == 0)
+                eof = true;
+        }
+
+        // true while the rest of pending is a bracketed paste that has not ended yet
+        bool pasting() const
+        {
+            return pending.starts_with("\x1b[200~");
+        }
+
+        // decodes whatever is left as if the sequence was complete. used when the rest of a sequence never arrives
+        void flush_pending()
+        {
+            while (!pending.empty())
+            {
+                size_t used = decode_one(pending, true);
+                pending.erase(0, used);
+            }
+        }
+
+        void decode()
+        {
+            size_t pos = 0;
+
+            while (pos < pending.size())
+            {
+                size_t used = decode_one(std::string_view(pending).substr(pos), false);
+
+                if (used == 0)
+                    break;
+
+                pos += used;
+            }
+
+            pending.erase(0, pos);
+        }
+
+        static Event key(Key k, bool ctrl = false, bool alt = false, bool shift = false)
+        {
+            Event e;
+
+            e.key   = k;
+            e.ctrl  = ctrl;
+            e.alt   = alt;
+            e.shift = shift;
+
+            return e;
+        }
+
+        // decodes one event from the front of str and returns the bytes used, or 0 if it needs more input.
+        // when final is set every byte is used up, an unfinished sequence becomes escape followed by its bytes
+        size_t decode_one(std::string_view str, bool final)
+        {
+            unsigned char c = str[0];
+
+            if (c == 0x1b)
+                return decode_escape(str, final);
+
+            if (c == '\r' || c == '\n')
+                events.push_back(key(Key::enter));
+            else if (c == '\t')
+                events.push_back(key(Key::tab));
+            else if (c == 0x7f || c == 0x08)
+                events.push_back(key(Key::backspace));
+            else if (c < 0x20)
+            {
+                // the control byte is the key with bit 0x40 cleared, letters are reported in lower case
+                Event e = key(Key::character, true);
+                e.ch = c | 0x40;
+
+                if (e.ch >= 'A' && e.ch <= 'Z')
+                    e.ch += 'a' - 'A';
+
+                events.push_back(e);
+            }
+            else
+                return decode_utf8(str, final, false);
+
+            return 1;
+        }
+
+        size_t decode_utf8(std::string_view str, bool final, bool alt)
+        {
+            unsigned char c = str[0];
+
+            size_t len = c < 0x80 ? 1 : (c >> 5) == 0x6 ? 2 : (c >> 4) == 0xe ? 3 : (c >> 3) == 0x1e ? 4 : 1;
+
+            if (str.size() < len)
+            {
+                if (!final)
+                    return 0;
+
+                len = 1;
+            }
+
+            char32_t cp = len == 1 ? c : c & (0x7f >> len);
+
+            for (size_t i = 1; i < len; i++)
+                cp = (cp << 6) | ((unsigned char)str[i] & 0x3f);
+
+            Event e = key(Key::character, false, alt);
+            e.ch = cp;
+            events.push_back(e);
+
+            return len;
+        }
+
+        size_t decode_escape(std::string_view str, bool final)
+        {
+            if (str.size() == 1)
+            {
+                if (!final)
+                    return 0;
+
+                events.push_back(key(Key::escape));
+                return 1;
+            }
+
+            char c = str[1];
+
+            if (c == '[')
+                return decode_csi(str, final);
+
+            if (c == 'O')
+            {
+                if (str.size() < 3)
+                {
+                    if (!final)
+                        return 0;
+
+                    Event e = key(Key::character, false, true);
+                    e.ch = 'O';
+                    events.push_back(e);
+                    return 2;
+                }
+
+                events.push_back(key(final_key(str[2], 1)));
+                return 3;
+            }
+
+            if (c == 0x1b)
+            {
+                events.push_back(key(Key::escape));
+                return 1;
+            }
+
+            // escape followed by a key is how terminals send alt
+            size_t used = decode_one(str.substr(1), final);
+
+            if (used == 0)
+                return 0;
+
+            events.back().alt = true;
+
+            return used + 1;
+        }
+
+        // maps the final byte of a CSI or SS3 sequence, with param being the first number of a '~' sequence
+        static Key final_key(char c, int param)
+        {
+            switch (c)
+            {
+                case 'A': return Key::up;
+                case 'B': return Key::down;
+                case 'C': return Key::right;
+                case 'D': return Key::left;
+                case 'H': return Key::home;
+                case 'F': return Key::end;
+                case 'Z': return Key::tab;
+                case 'P': return Key::f1;
+                case 'Q': return Key::f2;
+                case 'R': return Key::f3;
+                case 'S': return Key::f4;
+                case '~': break;
+                default:  return Key::unknown;
+            }
+
+            switch (param)
+            {
+                case 1: case 7: return Key::home;
+                case 2:         return Key::insert;
+                case 3:         return Key::del;
+                case 4: case 8: return Key::end;
+                case 5:         return Key::page_up;
+                case 6:         return Key::page_down;
+                case 11:        return Key::f1;
+                case 12:        return Key::f2;
+                case 13:        return Key::f3;
+                case 14:        return Key::f4;
+                case 15:        return Key::f5;
+                case 17:        return Key::f6;
+                case 18:        return Key::f7;
+                case 19:        return Key::f8;
+                case 20:        return Key::f9;
+                case 21:        return Key::f10;
+                case 23:        return Key::f11;
+                case 24:        return Key::f12;
+                default:        return Key::unknown;
+            }
+        }
+
+        size_t decode_csi(std::string_view str, bool final)
+        {
+            // legacy X10 mouse, ESC [ M followed by three raw bytes
+            if (str.size() >= 3 && str[2] == 'M')
+            {
+                if (str.size() < 6)
+                    return final ? unfinished() : 0;
+
+                int b = (unsigned char)str[3] - 32;
+                push_mouse(b, (unsigned char)str[5] - 32, (unsigned char)str[4] - 32, (b & 3) == 3);
+
+                return 6;
+            }
+
+            size_t end = 2;
+
+            while (end < str.size() && !((unsigned char)str[end] >= 0x40 && (unsigned char)str[end] <= 0x7e))
+                end++;
+
+            if (end == str.size())
+                return final ? unfinished() : 0;
+
+            std::string_view body = str.substr(2, end - 2);
+            char last = str[end];
+            size_t used = end + 1;
+
+            // SGR mouse, ESC [ < button ; column ; row M or m
+            if (!body.empty() && body[0] == '<')
+            {
+                auto p = params(body.substr(1));
+
+                if (p.size() == 3)
+                    push_mouse(p[0], p[2], p[1], last == 'm');
+
+                return used;
+            }
+
+            auto p = params(body);
+
+            int first = p.empty() ? 1 : p[0];
+            int mods  = p.size() > 1 ? p[1] - 1 : 0;
+
+            // bracketed paste, everything up to ESC [ 201 ~ is pasted text
+            if (last == '~' && first == 200)
+            {
+                size_t close = str.find("\x1b[201~", used);
+
+                // a paste cut off by the end of input is still delivered as pasted text and never as typed keys
+                if (close == std::string_view::npos)
+                {
+                    if (!final)
+                        return 0;
+
+                    Event e = key(Key::paste);
+                    e.text = str.substr(used);
+                    events.push_back(std::move(e));
+
+                    return str.size();
+                }
+
+                Event e = key(Key::paste);
+                e.text = str.substr(used, close - used);
+                events.push_back(std::move(e));
+
+                return close + 6;
+            }
+
+            events.push_back(key(final_key(last, first), mods & 4, mods & 2, (mods & 1) || last == 'Z'));
+
+            return used;
+        }
+
+        // an escape sequence that never finished is reported as escape and the rest is decoded as typed
+        size_t unfinished()
+        {
+            events.push_back(key(Key::escape));
+            return 1;
+        }
+
+        void push_mouse(int b, int row, int column, bool release)
+        {
+            Event e = key(Key::mouse, b & 16, b & 8, b & 4);
+
+            e.row    = row;
+            e.column = column;
+            e.motion = b & 32;
+
+            if (b & 64)
+                e.button = (b & 1) ? Mouse::wheel_down : Mouse::wheel_up;
+            else if (release)
+                e.button = Mouse::release;
+            else
+                e.button = (Mouse)(b & 3);
+
+            events.push_back(std::move(e));
+        }
+
+        static std::vector<int> params(std::string_view str)
+        {
+            std::vector<int> result;
+            int value = 0;
+            bool any = false;
+
+            for (char c : str)
+            {
+                // terminals never send more than a few digits, anything longer saturates instead of overflowing
+                if (c >= '0' && c <= '9')
+                {
+                    value = std::min(value * 10 + (c - '0'), 99999);
+                    any = true;
+                }
+                else if (c == ';')
+                {
+                    result.push_back(any ? value : 1);
+                    value = 0;
+                    any = false;
+                }
+            }
+
+            result.push_back(any ? value : 1);
+
+            return result;
+        }
+	};
+}
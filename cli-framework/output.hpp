@@ -0,0 +1,327 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <unordered_set>
+#include <charconv>
+#include <climits>
+#include <cerrno>
+#include <type_traits>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <poll.h>
+
+namespace cli
+{
+	// a buffered output sink that writes straight to a file descriptor without going through iostreams.
+	// every thread writes into its own buffer and hands complete lines off in large chunks through a lock free queue.
+	// whichever thread finds the queue idle writes all pending chunks with writev so lines from different threads never interleave
+	class Output
+	{
+	public:
+
+        explicit Output(int fd = STDOUT_FILENO, size_t buffer_size = 64 * 1024)
+            :
+                fd(fd),
+                buffer_size(buffer_size),
+                id(next_id())
+        {
+            std::lock_guard lock(registry().mtx);
+            registry().live.insert(id);
+        }
+
+        Output(const Output&) = delete;
+        Output& operator=(const Output&) = delete;
+
+        // all threads that wrote to the sink must be done with it by the time it is destroyed
+        ~Output()
+        {
+            {
+                std::lock_guard lock(registry().mtx);
+
+                registry().live.erase(id);
+                registry().retired++;
+            }
+
+            Buffer *list = buffers.exchange(nullptr);
+
+            // complete lines go first so a trailing partial line can only ever run into another partial line
+            for (Buffer *buff = list; buff; buff = buff->next)
+                handoff(*buff, false);
+
+            while (list)
+            {
+                if (!list->data.empty())
+                    handoff(*list, true);
+
+                Buffer *next = list->next;
+                delete list;
+                list = next;
+            }
+
+            drain();
+        }
+
+        // appends to the calling thread's buffer. only complete lines are written out unless flush is called
+        Output& write(std::string_view str)
+        {
+            Buffer &buff = local();
+
+            buff.data.append(str);
+
+            if (buff.data.size() >= buffer_size)
+                handoff(buff, false);
+
+            return *this;
+        }
+
+        // same signature as std::ostream::write so generic framework code can target either
+        Output& write(const char* str, std::streamsize n)
+        {
+            return write(std::string_view(str, (size_t)n));
+        }
+
+        // hands off everything the calling thread has buffered, including a partial line, and writes out all pending chunks.
+        // if another thread is already writing it will pick up the chunks instead
+        void flush()
+        {
+            Buffer &buff = local();
+
+            if (!buff.data.empty())
+                handoff(buff, true);
+
+            drain();
+        }
+
+        Output& operator<<(std::string_view str)    { return write(str); }
+        Output& operator<<(const std::string& str)  { return write(str); }
+        Output& operator<<(const char* str)         { return write(std::string_view(str)); }
+        Output& operator<<(char c)                  { return write(std::string_view(&c, 1)); }
+        Output& operator<<(bool b)                  { return write(b ? "1" : "0"); }
+
+        template<typename T> requires std::is_arithmetic_v<T>
+        Output& operator<<(T value)
+        {
+            char str[64];
+            auto [end, ec] = std::to_chars(str, str + sizeof(str), value);
+
+            return write(std::string_view(str, end - str));
+        }
+
+	private:
+
+        // a per thread buffer. they are owned by the sink so nothing is lost when a thread exits before flushing
+        struct Buffer
+        {
+            std::string data;
+            Buffer *next;
+        };
+
+        // a run of complete lines waiting to be written
+        struct Chunk
+        {
+            std::string data;
+            Chunk *next;
+        };
+
+        int fd;
+        size_t buffer_size;
+        uint64_t id;
+
+        std::atomic<Buffer*> buffers{nullptr};
+        std::atomic<Chunk*> pending{nullptr};
+        std::atomic_flag draining;
+
+        static uint64_t next_id()
+        {
+            static std::atomic<uint64_t> counter = 0;
+            return ++counter;
+        }
+
+        // the ids of the sinks that are alive and how many have been destroyed so far,
+        // which lets every thread notice a destroyed sink and drop its entry for it
+        struct Registry
+        {
+            std::mutex mtx;
+            std::unordered_set<uint64_t> live;
+            std::atomic<uint64_t> retired = 0;
+        };
+
+        static Registry& registry()
+        {
+            static Registry r;
+            return r;
+        }
+
+        // finds the calling thread's buffer for this sink, ids are never reused so stale entries never match
+        Buffer& local()
+        {
+            struct Entry
+            {
+                uint64_t id;
+                Buffer *buff;
+            };
+
+            thread_local std::vector<Entry> entries;
+            thread_local uint64_t retired = 0;
+
+            // only the sinks that are still alive are kept so the scan stays as short as the number the thread writes to
+            if (uint64_t now = registry().retired.load(); now != retired)
+            {
+                std::lock_guard lock(registry().mtx);
+
+                std::erase_if(entries, [](const Entry& e) { return !registry().live.contains(e.id); });
+                retired = now;
+            }
+
+            for (auto &e : entries)
+            {
+                if (e.id == id)
+                    return *e.buff;
+            }
+
+            auto *buff = new Buffer{ {}, buffers.load() };
+            buff->data.reserve(buffer_size);
+
+            while (!buffers.compare_exchange_weak(buff->next, buff))
+            {}
+
+            entries.push_back({id, buff});
+
+            return *buff;
+        }
+
+        // moves the complete lines of the buffer into a chunk, or all of it if partial is set
+        void handoff(Buffer& buff, bool partial)
+        {
+            size_t cut = buff.data.size();
+
+            if (!partial)
+            {
+                size_t nl = buff.data.rfind('\n');
+
+                if (nl == std::string::npos)
+                    return;
+
+                cut = nl + 1;
+            }
+
+            auto *chunk = new Chunk{ std::move(buff.data), pending.load() };
+
+            buff.data = std::string();
+            buff.data.reserve(buffer_size);
+            buff.data.append(chunk->data, cut);
+            chunk->data.resize(cut);
+
+            while (!pending.compare_exchange_weak(chunk->next, chunk))
+            {}
+
+            drain();
+        }
+
+        // only one thread writes at a time. a thread that hands off a chunk while another is writing leaves it to that thread,
+        // which checks for new chunks after it is done so nothing is left behind
+        void drain()
+        {
+            do
+            {
+                if (draining.test_and_set())
+                    return;
+
+                Chunk *list = pending.exchange(nullptr);
+                Chunk *ordered = nullptr;
+
+                // chunks are pushed onto a stack so they have to be reversed to keep each thread's lines in order
+                while (list)
+                {
+                    Chunk *next = list->next;
+                    list->next = ordered;
+                    ordered = list;
+                    list = next;
+                }
+
+                write_chunks(ordered);
+
+                draining.clear();
+            }
+            while (pending.load());
+        }
+
+        void write_chunks(Chunk* list)
+        {
+#ifdef IOV_MAX
+            constexpr size_t max_iov = IOV_MAX;
+#else
+            constexpr size_t max_iov = 1024;
+#endif
+            std::vector<iovec> iov;
+
+            while (list)
+            {
+                iov.clear();
+
+                Chunk *end = list;
+
+                for (; end && iov.size() < max_iov; end = end->next)
+                {
+                    if (!end->data.empty())
+                        iov.push_back({ end->data.data(), end->data.size() });
+                }
+
+                write_all(iov);
+
+                while (list != end)
+                {
+                    Chunk *next = list->next;
+                    delete list;
+                    list = next;
+                }
+            }
+        }
+
+        // keeps calling writev until everything is written, a failing descriptor drops the rest of the batch
+        void write_all(std::vector<iovec>& iov)
+        {
+            iovec *vec = iov.data();
+            int count = (int)iov.size();
+
+            while (count > 0)
+            {
+                ssize_t n = ::writev(fd, vec, count);
+
+                if (n < 0)
+                {
+                    if (errno == EINTR)
+                        continue;
+
+                    // a non blocking descriptor is waited on instead of spinning until it drains
+                    if (errno == EAGAIN || errno == EWOULDBLOCK)
+                    {
+                        pollfd out{ fd, POLLOUT, 0 };
+
+                        if (poll(&out, 1, -1) >= 0 || errno == EINTR)
+                            continue;
+                    }
+
+                    return;
+                }
+
+                while (count > 0 && (size_t)n >= vec->iov_len)
+                {
+                    n -= (ssize_t)vec->iov_len;
+                    vec++;
+                    count--;
+                }
+
+                if (count > 0)
+                {
+                    vec->iov_base = (char*)vec->iov_base + n;
+                    vec->iov_len -= n;
+                }
+            }
+        }
+	};
+}
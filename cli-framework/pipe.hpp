@@ -0,0 +1,537 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <exception>
+#include <algorithm>
+#include <span>
+#include <atomic>
+#include <streambuf>
+#include <ostream>
+#include <system_error>
+#include <cerrno>
+#include <cstdint>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "command.hpp"
+#include "tokenize.hpp"
+
+namespace cli
+{
+	// a bounded single producer single consumer byte stream between two threads.
+	// the ring is mapped twice back to back in memory so every readable or writable region is contiguous,
+	// which lets the producer write straight into the ring and the consumer read straight out of it.
+	// a full ring blocks the producer and an empty one blocks the consumer, both without polling
+	class Pipe
+	{
+	public:
+
+        // capacity is rounded up to a multiple of the page size
+        explicit Pipe(size_t capacity = 256 * 1024)
+        {
+            size_t page = (size_t)sysconf(_SC_PAGESIZE);
+            size = (std::max<size_t>(capacity, 1) + page - 1) / page * page;
+
+            int fd = memfd_create("cli-pipe", MFD_CLOEXEC);
+
+            if (fd < 0)
+                throw std::system_error(errno, std::generic_category(), "memfd_create");
+
+            if (ftruncate(fd, (off_t)size) != 0)
+            {
+                int err = errno;
+                ::close(fd);
+                throw std::system_error(err, std::generic_category(), "ftruncate");
+            }
+
+            // reserve twice the size and then map the same memory into both halves
+            void *area = mmap(nullptr, size * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+            bool mapped = area != MAP_FAILED &&
+                mmap(area, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED &&
+                mmap((char*)area + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED;
+
+            int err = errno;
+            ::close(fd);
+
+            if (!mapped)
+            {
+                if (area != MAP_FAILED)
+                    munmap(area, size * 2);
+
+                throw std::system_error(err, std::generic_category(), "mmap");
+            }
+
+            buff = (char*)area;
+        }
+
+        Pipe(const Pipe&) = delete;
+        Pipe& operator=(const Pipe&) = delete;
+
+        ~Pipe()
+        {
+            munmap(buff, size * 2);
+        }
+
+        // ==================================================
+        // producer side
+
+        // returns the free space to write into, waiting until there are at least min bytes of it.
+        // empty when the consumer is gone, the bytes only show up for the consumer once they are committed
+        std::span<char> reserve(size_t min = 1)
+        {
+            uint64_t h = head.load(std::memory_order_relaxed);
+            min = std::clamp<size_t>(min, 1, size);
+
+            while (true)
+            {
+                uint64_t t = tail.load(std::memory_order_acquire);
+
+                if (t & closed_bit)
+                    return {};
+
+                size_t used = (size_t)(h - t);
+
+                if (size - used >= min)
+                    return { buff + (h % size), size - used };
+
+                sleep(tail, t, writer_waiting);
+            }
+        }
+
+        void commit(size_t n)
+        {
+            if (n == 0)
+                return;
+
+            head.fetch_add(n);
+            wake(head, reader_waiting);
+        }
+
+        // copies data into the pipe, returns false if the consumer is gone
+        bool write(std::string_view data)
+        {
+            while (!data.empty())
+            {
+                std::span<char> space = reserve();
+
+                if (space.empty())
+                    return false;
+
+                size_t n = std::min(space.size(), data.size());
+
+                std::copy_n(data.data(), n, space.data());
+                commit(n);
+
+                data.remove_prefix(n);
+            }
+
+            return true;
+        }
+
+        // marks the end of the stream, the consumer gets the rest and then sees the end
+        void close()
+        {
+            head.fetch_or(closed_bit);
+            wake(head, reader_waiting);
+        }
+
+        // ==================================================
+        // consumer side
+
+        // returns everything that can be read, waiting until there is something.
+        // empty at the end of the stream. the view stays valid until consume
+        std::string_view read()
+        {
+            uint64_t t = tail.load(std::memory_order_relaxed) & ~closed_bit;
+
+            while (true)
+            {
+                uint64_t h = head.load(std::memory_order_acquire);
+                size_t available = (size_t)((h & ~closed_bit) - t);
+
+                if (available > 0)
+                    return { buff + (t % size), available };
+
+                if (h & closed_bit)
+                    return {};
+
+                sleep(head, h, reader_waiting);
+            }
+        }
+
+        void consume(size_t n)
+        {
+            if (n == 0)
+                return;
+
+            tail.fetch_add(n);
+            wake(tail, writer_waiting);
+        }
+
+        // returns the next line without its '\n' as a view into the pipe which stays valid until the next read call.
+        // a line longer than the capacity of the pipe comes back in pieces. false at the end of the stream
+        bool read_line(std::string_view& line)
+        {
+            consume(line_used);
+            line_used = 0;
+
+            size_t seen = 0;
+
+            while (true)
+            {
+                std::string_view data = read();
+
+                if (data.empty())
+                    return false;
+
+                size_t nl = data.find('\n', seen);
+
+                if (nl != std::string_view::npos)
+                {
+                    line = data.substr(0, nl);
+                    line_used = nl + 1;
+                    return true;
+                }
+
+                // the last line of the stream has no '\n', or it did not fit and has to be split
+                if (data.size() == size || finished(data.size()))
+                {
+                    line = data;
+                    line_used = data.size();
+                    return true;
+                }
+
+                seen = data.size();
+                wait_for_more(data.size());
+            }
+        }
+
+        // tells the producer nothing more will be read so it stops instead of blocking on a full pipe
+        void close_read()
+        {
+            tail.fetch_or(closed_bit);
+            wake(tail, writer_waiting);
+        }
+
+	private:
+
+        // the top bit of head and tail marks the side that closed, setting it also wakes anyone waiting on the other side
+        static constexpr uint64_t closed_bit = uint64_t(1) << 63;
+
+        char *buff = nullptr;
+        size_t size = 0;
+        size_t line_used = 0;
+
+        // kept on separate cache lines so the two threads do not fight over them
+        alignas(64) std::atomic<uint64_t> head{0};
+        std::atomic<bool> reader_waiting{false};
+
+        alignas(64) std::atomic<uint64_t> tail{0};
+        std::atomic<bool> writer_waiting{false};
+
+        // a side only notifies when the other one announced it is about to sleep,
+        // which saves a futex call on almost every commit and consume while both sides are busy
+        static void sleep(std::atomic<uint64_t>& value, uint64_t old, std::atomic<bool>& waiting)
+        {
+            // the other side usually follows within a few hundred nanoseconds so spin briefly before paying for a futex.
+            // with a single core the other side can not run while this one spins
+            static const int spins = std::thread::hardware_concurrency() > 1 ? 256 : 0;
+
+            for (int i = 0; i < spins; i++)
+            {
+                if (value.load(std::memory_order_relaxed) != old)
+                    return;
+
+                pause();
+            }
+
+            waiting.store(true);
+
+            if (value.load() == old)
+                value.wait(old);
+
+            waiting.store(false);
+        }
+
+        static void pause()
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#elif defined(__aarch64__)
+            asm volatile("yield");
+#endif
+        }
+
+        static void wake(std::atomic<uint64_t>& value, std::atomic<bool>& waiting)
+        {
+            if (waiting.load())
+                value.notify_one();
+        }
+
+        // true if the producer closed the stream and everything after tail has been seen
+        bool finished(size_t available) const
+        {
+            uint64_t h = head.load(std::memory_order_acquire);
+            uint64_t t = tail.load(std::memory_order_relaxed) & ~closed_bit;
+
+            return (h & closed_bit) && (size_t)((h & ~closed_bit) - t) == available;
+        }
+
+        void wait_for_more(size_t available)
+        {
+            uint64_t t = tail.load(std::memory_order_relaxed) & ~closed_bit;
+
+            while (true)
+            {
+                uint64_t h = head.load(std::memory_order_acquire);
+
+                if ((h & closed_bit) || (size_t)((h & ~closed_bit) - t) > available)
+                    return;
+
+                sleep(head, h, reader_waiting);
+            }
+        }
+	};
+
+	// a streambuf whose put area is the free space of a pipe, so anything written to an ostream over it goes
+	// straight into the ring. it lets commands that only implement write take part in a pipeline
+	class PipeBuf : public std::streambuf
+	{
+	public:
+
+        explicit PipeBuf(Pipe& pipe)
+            : pipe(pipe)
+        {}
+
+        ~PipeBuf()
+        {
+            sync();
+        }
+
+	protected:
+
+        int_type overflow(int_type c) override
+        {
+            pipe.commit(pptr() - pbase());
+
+            std::span<char> space = pipe.reserve();
+
+            if (space.empty())
+            {
+                setp(nullptr, nullptr);
+                return traits_type::eof();
+            }
+
+            setp(space.data(), space.data() + space.size());
+
+            if (!traits_type::eq_int_type(c, traits_type::eof()))
+            {
+                *pptr() = traits_type::to_char_type(c);
+                pbump(1);
+            }
+
+            return traits_type::not_eof(c);
+        }
+
+        int sync() override
+        {
+            pipe.commit(pptr() - pbase());
+            setp(pptr(), epptr());
+
+            return 0;
+        }
+
+	private:
+		Pipe& pipe;
+	};
+
+	namespace detail
+	{
+		// runs the stages of a pipeline that has already been split up, see cli::pipeline
+		template<typename Out>
+		CommandHandler::Result run_pipeline(CommandHandler& handler, std::vector<CommandHandler::Args> commands, Out& os, size_t capacity)
+		{
+			struct Stage
+			{
+				CommandHandler::Command *cmd;
+				std::string path;
+				CommandHandler::Args args;
+			};
+
+			std::vector<Stage> stages(commands.size());
+
+			for (size_t i = 0; i < commands.size(); i++)
+				stages[i].args = std::move(commands[i]);
+
+			// stages run at the same time and a command binds its flags to the same variables every time,
+			// so a level with flags can only be part of one stage
+			std::vector<CommandHandler::Command*> flagged;
+
+			for (auto &stage : stages)
+			{
+				if (stage.args.empty())
+					return {"empty pipeline stage", false};
+
+				std::string name = std::move(stage.args[0]);
+				stage.args.erase(stage.args.begin());
+
+				CommandHandler::Result result;
+				stage.cmd = handler.lookup(name, stage.args, stage.path, result);
+
+				if (!stage.cmd)
+					return result;
+
+				CommandHandler *level = &handler;
+
+				for (size_t start = 0, end; level && start < stage.path.size(); start = end + 1)
+				{
+					end = std::min(stage.path.find(' ', start), stage.path.size());
+
+					CommandHandler::Command *cmd = level->find(std::string_view(stage.path).substr(start, end - start));
+
+					if (!cmd)
+						break;
+
+					if (!cmd->flags.flags.empty())
+					{
+						if (std::find(flagged.begin(), flagged.end(), cmd) != flagged.end())
+							return {"command with flags used in more than one pipeline stage", false};
+
+						flagged.push_back(cmd);
+					}
+
+					level = cmd->children.get();
+				}
+
+				if (!stage.cmd->pipe && !stage.cmd->write)
+					return {"command can not be used in a pipeline", false};
+
+				// write never reads its input, after the first stage it would drop everything before it
+				if (&stage != &stages.front() && !stage.cmd->pipe)
+					return {"command is not a filter", false};
+			}
+
+			// pipes[i] feeds stage i, the first stage gets an empty stream
+			std::vector<std::unique_ptr<Pipe>> pipes;
+
+			try
+			{
+				for (size_t i = 0; i <= stages.size(); i++)
+					pipes.push_back(std::make_unique<Pipe>(i == 0 ? 1 : capacity));
+			}
+			catch (const std::system_error&)
+			{
+				return {"could not create pipeline", false};
+			}
+
+			pipes[0]->close();
+
+			// cooldowns only start once every stage is known to be able to run
+			std::vector<std::pair<std::string_view, CommandHandler::Command*>> cooldowns;
+
+			for (auto &stage : stages)
+				cooldowns.emplace_back(stage.path, stage.cmd);
+
+			if (!handler.start_cooldowns(cooldowns))
+				return {"command is on cooldown", false};
+
+			std::vector<std::exception_ptr> errors(stages.size());
+			std::vector<std::thread> threads;
+
+			for (size_t i = 0; i < stages.size(); i++)
+			{
+				threads.emplace_back([&, i]
+				{
+					Stage &stage = stages[i];
+					Pipe &in = *pipes[i];
+					Pipe &out = *pipes[i + 1];
+
+					try
+					{
+						if (stage.cmd->pipe)
+							stage.cmd->pipe(std::move(stage.args), in, out);
+						else
+						{
+							PipeBuf buff(out);
+							std::ostream stream(&buff);
+
+							stage.cmd->write(std::move(stage.args), stream);
+						}
+					}
+					catch (...)
+					{
+						errors[i] = std::current_exception();
+					}
+
+					out.close();
+					in.close_read();
+				});
+			}
+
+			Pipe &last = *pipes.back();
+
+			for (std::string_view data; !(data = last.read()).empty();)
+			{
+				os.write(data.data(), (std::streamsize)data.size());
+				last.consume(data.size());
+			}
+
+			for (auto &t : threads)
+				t.join();
+
+			for (auto &e : errors)
+			{
+				if (e)
+					std::rethrow_exception(e);
+			}
+
+			return {nullptr, true};
+		}
+	}
+
+	// runs "a x | b y | c" in process. tokens are the words of the whole line and every "|" starts a new stage.
+	// each stage runs on its own thread and hands its output to the next through a Pipe, the output of the last
+	// stage goes to os. stages use the pipe function of their command, the first stage can also use write since it reads nothing.
+	// every stage is checked and the pipes are created before any cooldown starts, a command used by several stages counts once.
+	// a stage that returns early closes its input so the stages before it stop instead of blocking
+	template<typename Out>
+	CommandHandler::Result pipeline(CommandHandler& handler, const CommandHandler::Args& tokens, Out& os, size_t capacity = 256 * 1024)
+	{
+		std::vector<CommandHandler::Args> commands(1);
+
+		for (const auto &token : tokens)
+		{
+			if (token == "|")
+				commands.emplace_back();
+			else
+				commands.back().push_back(token);
+		}
+
+		return detail::run_pipeline(handler, std::move(commands), os, capacity);
+	}
+
+	// same as above for a line split by cli::tokenize, where only an unquoted "|" starts a new stage
+	template<typename Out>
+	CommandHandler::Result pipeline(CommandHandler& handler, const Tokens& tokens, Out& os, size_t capacity = 256 * 1024)
+	{
+		std::vector<CommandHandler::Args> commands(1);
+		size_t next = 0;
+
+		for (size_t i = 0; i < tokens.size(); i++)
+		{
+			if (next < tokens.operators.size() && tokens.operators[next] == i)
+			{
+				commands.emplace_back();
+				next++;
+			}
+			else
+				commands.back().emplace_back(tokens[i]);
+		}
+
+		return detail::run_pipeline(handler, std::move(commands), os, capacity);
+	}
+}
\ No newline at end of file
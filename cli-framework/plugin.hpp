@@ -0,0 +1,220 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <fstream>
+#include <dlfcn.h>
+#include "command.hpp"
+
+namespace cli
+{
+	// commands whose implementation lives in shared objects that are only loaded on first dispatch.
+	// a manifest lists the name, aliases and description of every command so lookup and help work without loading anything.
+	//
+	// manifest lines look like: name | alias1,alias2 | cooldown | library.so | symbol | description
+	// empty lines and lines starting with # are ignored.
+	//
+	// the symbol must be an extern "C" function with the signature of Plugins::SetupFN.
+	// it fills in exec, write or pipe of the command it is given and optionally its flags, subcommands and cache_ttl,
+	// which are copied into the installed command when it is loaded. alias, description and cooldown come from the manifest
+	class Plugins
+	{
+	public:
+
+        using SetupFN = void(*)(CommandHandler::Command&);
+
+        struct Entry
+        {
+            std::string name;
+            std::vector<std::string> alias;
+            std::string description;
+            size_t cooldown;
+            std::string library;
+            std::string symbol;
+
+            std::once_flag once;
+            std::string error;
+            CommandHandler::Command loaded;
+        };
+
+        Plugins() = default;
+
+        Plugins(const Plugins&) = delete;
+        Plugins& operator=(const Plugins&) = delete;
+
+        // reads a manifest file, returns false if it cannot be opened or a line is malformed
+        bool load(const std::string& path)
+        {
+            std::ifstream file(path);
+
+            if (!file)
+                return false;
+
+            std::string line;
+
+            while (std::getline(file, line))
+            {
+                if (!parse_line(line))
+                    return false;
+            }
+
+            return true;
+        }
+
+        // adds a command for every manifest entry that loads its plugin the first time it is looked up.
+        // the plugins must outlive the handler since it refers to their names
+        void install(CommandHandler& handler)
+        {
+            for (Entry &e : entries)
+            {
+                Entry *entry = &e;
+
+                handler.cmds[e.name] = CommandHandler::Command
+                {
+                    .alias       = e.alias,
+                    .description = e.description,
+                    .cooldown    = e.cooldown,
+                    .exec        = nullptr,
+                    .load        = [entry](CommandHandler::Command& cmd)
+                    {
+                        if (!ready(*entry))
+                            return false;
+
+                        // the first load fills in the command, fan_out and pipelines then see what the plugin really implements
+                        if (!cmd.exec && !cmd.write && !cmd.pipe)
+                        {
+                            const CommandHandler::Command &loaded = entry->loaded;
+
+                            cmd.exec      = loaded.exec;
+                            cmd.write     = loaded.write;
+                            cmd.pipe      = loaded.pipe;
+                            cmd.cache_ttl = loaded.cache_ttl;
+                            cmd.flags     = loaded.flags;
+                            cmd.children  = loaded.children;
+                        }
+
+                        return true;
+                    }
+                };
+            }
+        }
+
+        // a deque so entries never move once the handler refers to them
+        std::deque<Entry> entries;
+
+	private:
+
+        // loads the plugin the first time the command is looked up and returns false if that failed.
+        // safe to call from several threads at once, e.g. through fan_out.
+        // handles are never closed so the functions copied out of a plugin stay valid for the life of the process
+        static bool ready(Entry& e)
+        {
+            std::call_once(e.once, [&e]
+            {
+                void *handle = dlopen(e.library.c_str(), RTLD_NOW | RTLD_LOCAL);
+
+                if (!handle)
+                {
+                    e.error = dlerror();
+                    return;
+                }
+
+                auto setup = (SetupFN)dlsym(handle, e.symbol.c_str());
+
+                if (!setup)
+                {
+                    e.error = dlerror();
+                    return;
+                }
+
+                setup(e.loaded);
+
+                if (!e.loaded.exec && !e.loaded.write && !e.loaded.pipe)
+                    e.error = e.symbol + " did not set up " + e.name;
+            });
+
+            return e.error.empty();
+        }
+
+        static std::string_view trim(std::string_view str)
+        {
+            size_t start = str.find_first_not_of(" \t\r");
+
+            if (start == std::string_view::npos)
+                return {};
+
+            size_t end = str.find_last_not_of(" \t\r");
+
+            return str.substr(start, end - start + 1);
+        }
+
+        static std::vector<std::string_view> split(std::string_view str, char seperator, size_t limit)
+        {
+            std::vector<std::string_view> result;
+
+            while (result.size() + 1 < limit)
+            {
+                size_t i = str.find(seperator);
+
+                if (i == std::string_view::npos)
+                    break;
+
+                result.push_back(trim(str.substr(0, i)));
+                str.remove_prefix(i + 1);
+            }
+
+            result.push_back(trim(str));
+
+            return result;
+        }
+
+        bool parse_line(std::string_view line)
+        {
+            line = trim(line);
+
+            if (line.empty() || line[0] == '#')
+                return true;
+
+            // the description is last so it is free to contain the seperator
+            auto fields = split(line, '|', 6);
+
+            if (fields.size() != 6 || fields[0].empty() || fields[3].empty() || fields[4].empty())
+                return false;
+
+            Entry &e = entries.emplace_back();
+
+            e.name        = fields[0];
+            e.library     = fields[3];
+            e.symbol      = fields[4];
+            e.description = fields[5];
+            e.cooldown    = 0;
+
+            if (!fields[1].empty())
+            {
+                for (std::string_view alias : split(fields[1], ',', std::string_view::npos))
+                {
+                    if (!alias.empty())
+                        e.alias.emplace_back(alias);
+                }
+            }
+
+            if (!fields[2].empty())
+            {
+                try
+                {
+                    e.cooldown = std::stoull(std::string(fields[2]));
+                }
+                catch (...)
+                {
+                    entries.pop_back();
+                    return false;
+                }
+            }
+
+            return true;
+        }
+	};
+}
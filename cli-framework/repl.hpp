@@ -0,0 +1,705 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <optional>
+#include <map>
+#include <algorithm>
+#include <iostream>
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include "command.hpp"
+#include "flags.hpp"
+#include "input.hpp"
+#include "trie.hpp"
+#include "pipe.hpp"
+#include "ansi.hpp"
+#include "tokenize.hpp"
+
+namespace cli
+{
+	// an interactive prompt on top of CommandHandler::run with line editing, history and tab completion.
+	//
+	// keys: left/right, home/end (ctrl-a/e), backspace/delete, ctrl-k/u/w to kill to the end, the start or a word,
+	// up/down to walk the history, ctrl-r to search it, tab to complete, ctrl-c to drop the line and ctrl-d on an empty line to quit.
+	//
+	// lines are split into words by cli::tokenize, so quotes, escapes and # comments work like in a shell.
+	// lines with an unquoted "|" run as an in process pipeline, see cli::pipeline.
+	// the history file is only ever appended to so several sessions can share it.
+	// stdin and stdout stay in blocking mode so commands can write as much output as they like
+	class Repl
+	{
+	public:
+
+        Repl(CommandHandler& handler, std::string prompt = "> ", std::string history_path = "")
+            :
+                handler(handler),
+                prompt(std::move(prompt)),
+                history_path(std::move(history_path))
+        {
+            if (isatty(STDIN_FILENO))
+                input.emplace();
+
+            load_history();
+            refresh();
+        }
+
+        // adds a word that completes after the command name of every command, e.g. a flag of the program.
+        // the flags of the commands themselves are completed without it
+        Repl& complete(std::string_view word)
+        {
+            words.insert(word, true);
+
+            for (auto& [cmd, trie] : levels)
+                trie.insert(word, true);
+
+            return *this;
+        }
+
+        // adds every flag of the parser to the completions
+        Repl& complete(const Flags& flags)
+        {
+            for (const auto& [name, data] : flags.flags)
+                complete(name);
+
+            return *this;
+        }
+
+        // rebuilds the command completions, call it after changing handler.cmds
+        void refresh()
+        {
+            commands.clear();
+            levels.clear();
+
+            for (auto& [name, cmd] : handler.cmds)
+            {
+                commands.insert(name, true);
+
+                for (const auto& alias : cmd.alias)
+                    commands.insert(alias, true);
+
+                index(cmd, {});
+            }
+        }
+
+        // reads lines and runs them as commands until ctrl-d or the end of input.
+        // output of commands that implement write goes to os
+        void run(std::ostream& os = std::cout)
+        {
+            while (auto line = read_line())
+            {
+                Tokens tokens = tokenize(*line);
+
+                if (tokens.error)
+                {
+                    os << tokens.error << std::endl;
+                    continue;
+                }
+
+                if (tokens.empty())
+                    continue;
+
+                if (!tokens.operators.empty())
+                {
+                    auto result = pipeline(handler, tokens, os);
+
+                    if (!result.ok)
+                        os << result.message << '\n';
+
+                    os << std::flush;
+                    continue;
+                }
+
+                CommandHandler::Args args = tokens.args();
+                std::string name = std::move(args[0]);
+                args.erase(args.begin());
+
+                auto result = handler.run(name, args, os);
+
+                if (!result.ok)
+                    os << result.message << '\n';
+
+                os << std::flush;
+            }
+        }
+
+        // reads one edited line, returns nothing at the end of input
+        std::optional<std::string> read_line()
+        {
+            if (!input)
+            {
+                std::string line;
+
+                if (!std::getline(std::cin, line))
+                    return std::nullopt;
+
+                add_history(line);
+                return line;
+            }
+
+            std::cout << std::flush;
+
+            Terminal terminal(false, true);
+
+            buff.clear();
+            cursor = 0;
+            searching = false;
+            history_index = history.size();
+
+            render();
+
+            while (auto event = input->next())
+            {
+                switch (handle(*event))
+                {
+                    case Action::none:
+                        break;
+
+                    case Action::accept:
+                    {
+                        std::string line = utf8(buff);
+
+                        put("\n");
+                        add_history(line);
+
+                        return line;
+                    }
+
+                    case Action::quit:
+                        put("\n");
+                        return std::nullopt;
+                }
+            }
+
+            put("\n");
+
+            return std::nullopt;
+        }
+
+        std::vector<std::string> history;
+
+	private:
+
+        enum class Action
+        {
+            none,
+            accept,
+            quit
+        };
+
+        CommandHandler& handler;
+        std::string prompt;
+        std::string history_path;
+        std::optional<Input> input;
+
+        Trie<bool> commands;
+        Trie<bool> words;
+
+        // what completes after each command: the names and aliases of its subcommands, the flags of every level on its path
+        // and the words added through complete
+        std::map<const CommandHandler::Command*, Trie<bool>> levels;
+
+        std::u32string buff;
+        size_t cursor = 0;
+        size_t history_index = 0;
+
+        bool searching = false;
+        std::u32string query;
+        size_t match = 0;
+
+        Action handle(const Event& e)
+        {
+            if (searching)
+                return handle_search(e);
+
+            switch (e.key)
+            {
+                case Key::enter:
+                    return Action::accept;
+
+                case Key::character:
+                    if (e.ctrl)
+                        return handle_ctrl(e.ch);
+
+                    insert(std::u32string(1, e.ch));
+                    return Action::none;
+
+                case Key::paste:
+                    insert(from_utf8(e.text));
+                    return Action::none;
+
+                case Key::tab:        tab();                          break;
+                case Key::left:       if (cursor > 0) cursor--;       break;
+                case Key::right:      if (cursor < buff.size()) cursor++; break;
+                case Key::home:       cursor = 0;                     break;
+                case Key::end:        cursor = buff.size();           break;
+                case Key::up:         walk_history(-1);               break;
+                case Key::down:       walk_history(1);                break;
+
+                case Key::backspace:
+                    if (e.alt)
+                        kill_word();
+                    else if (cursor > 0)
+                        buff.erase(--cursor, 1);
+                    break;
+
+                case Key::del:
+                    if (cursor < buff.size())
+                        buff.erase(cursor, 1);
+                    break;
+
+                default:
+                    return Action::none;
+            }
+
+            render();
+
+            return Action::none;
+        }
+
+        Action handle_ctrl(char32_t c)
+        {
+            switch (c)
+            {
+                case 'a': cursor = 0;                   break;
+                case 'e': cursor = buff.size();         break;
+                case 'b': if (cursor > 0) cursor--;     break;
+                case 'f': if (cursor < buff.size()) cursor++; break;
+                case 'p': walk_history(-1);             break;
+                case 'n': walk_history(1);              break;
+                case 'k': buff.erase(cursor);           break;
+                case 'w': kill_word();                  break;
+
+                case 'u':
+                    buff.erase(0, cursor);
+                    cursor = 0;
+                    break;
+
+                case 'c':
+                    put("^C\n");
+                    buff.clear();
+                    cursor = 0;
+                    history_index = history.size();
+                    break;
+
+                case 'd':
+                    if (buff.empty())
+                        return Action::quit;
+
+                    if (cursor < buff.size())
+                        buff.erase(cursor, 1);
+                    break;
+
+                case 'l':
+                    put(eraseScreen(2) + cursorPosition(1, 1));
+                    break;
+
+                case 'r':
+                    searching = true;
+                    query.clear();
+                    match = history.size();
+                    break;
+
+                default:
+                    return Action::none;
+            }
+
+            render();
+
+            return Action::none;
+        }
+
+        // incremental reverse search. typing narrows the match, ctrl-r jumps to the next older one and
+        // any other key takes the match into the line and is handled as usual
+        Action handle_search(const Event& e)
+        {
+            if (e.key == Key::character && !e.ctrl)
+            {
+                query += e.ch;
+                search(std::min(match + 1, history.size()));
+            }
+            else if (e.key == Key::backspace)
+            {
+                if (!query.empty())
+                    query.pop_back();
+
+                search(history.size());
+            }
+            else if (e.key == Key::character && e.ctrl && e.ch == 'r')
+                search(match);
+            else if (e.key == Key::character && e.ctrl && (e.ch == 'g' || e.ch == 'c'))
+            {
+                searching = false;
+                buff.clear();
+                cursor = 0;
+            }
+            else
+            {
+                searching = false;
+                return handle(e);
+            }
+
+            render();
+
+            return Action::none;
+        }
+
+        // finds the newest history entry before from that contains the query
+        void search(size_t from)
+        {
+            std::string needle = utf8(query);
+
+            for (size_t i = from; i-- > 0;)
+            {
+                if (history[i].find(needle) != std::string::npos)
+                {
+                    match = i;
+                    buff = from_utf8(history[i]);
+                    cursor = buff.size();
+                    return;
+                }
+            }
+        }
+
+        void insert(const std::u32string& str)
+        {
+            std::u32string text;
+
+            for (char32_t c : str)
+            {
+                if (c != '\n' && c != '\r')
+                    text += c;
+            }
+
+            bool at_end = cursor == buff.size();
+
+            buff.insert(cursor, text);
+            cursor += text.size();
+
+            // typing at the end of the line only echoes the new text instead of redrawing it
+            if (at_end && !searching)
+                put(utf8(text));
+            else
+                render();
+        }
+
+        void kill_word()
+        {
+            size_t start = cursor;
+
+            while (start > 0 && buff[start - 1] == ' ')
+                start--;
+
+            while (start > 0 && buff[start - 1] != ' ')
+                start--;
+
+            buff.erase(start, cursor - start);
+            cursor = start;
+        }
+
+        void walk_history(int step)
+        {
+            if (step < 0 && history_index == 0)
+                return;
+
+            if (step > 0 && history_index >= history.size())
+                return;
+
+            history_index += step;
+
+            buff = history_index < history.size() ? from_utf8(history[history_index]) : std::u32string();
+            cursor = buff.size();
+        }
+
+        // completes the word under the cursor. commands are completed for the first word, after that the subcommands and
+        // flags of the command path, a single match is completed in full, several are listed below the line
+        void tab()
+        {
+            size_t start = cursor;
+
+            while (start > 0 && buff[start - 1] != ' ')
+                start--;
+
+            bool first = buff.find_first_not_of(U' ') >= start;
+            std::string prefix = utf8(buff.substr(start, cursor - start));
+            Trie<bool> &trie = first ? commands : completions_at(utf8(buff.substr(0, start)), prefix);
+
+            std::vector<std::string> matches;
+            trie.complete(prefix, matches, 64);
+
+            if (matches.empty())
+                return;
+
+            std::string completed = matches.size() == 1 ? matches[0] + ' ' : trie.extend(prefix);
+
+            if (completed.size() > prefix.size())
+            {
+                std::u32string text = from_utf8(completed.substr(prefix.size()));
+
+                buff.insert(cursor, text);
+                cursor += text.size();
+
+                return;
+            }
+
+            std::string list = "\n";
+
+            for (const auto &m : matches)
+                list += m + "  ";
+
+            put(list + "\n");
+        }
+
+        void index(const CommandHandler::Command& cmd, std::vector<const Flags*> path)
+        {
+            Trie<bool> &trie = levels[&cmd];
+
+            path.push_back(&cmd.flags);
+
+            for (const Flags *flags : path)
+            {
+                for (const auto& [name, data] : flags->flags)
+                    trie.insert(name, true);
+            }
+
+            std::vector<std::string> extra;
+            words.complete("", extra);
+
+            for (const auto &word : extra)
+                trie.insert(word, true);
+
+            if (!cmd.children)
+                return;
+
+            for (const auto& [name, child] : cmd.children->cmds)
+            {
+                trie.insert(name, true);
+
+                for (const auto& alias : child.alias)
+                    trie.insert(alias, true);
+
+                index(child, path);
+            }
+        }
+
+        // returns the completions for the word after before by walking the command path it names like lookup does.
+        // subcommands only complete until the first positional argument, flags of the path complete anywhere after it
+        Trie<bool>& completions_at(const std::string& before, const std::string& prefix)
+        {
+            CommandHandler *level = &handler;
+            CommandHandler::Command *cmd = nullptr;
+            std::vector<const Flags*> path;
+            bool positional = false;
+            bool value = false;
+
+            for (std::string_view word : tokenize(before))
+            {
+                // the word after a flag that is not a bool is its value
+                if (value)
+                {
+                    value = false;
+                    continue;
+                }
+
+                // "--" ends flags and the path like it does for lookup
+                if (word == "--")
+                    return words;
+
+                if (word.starts_with('-'))
+                {
+                    for (const Flags *flags : path)
+                    {
+                        auto it = flags->flags.find(std::string(word));
+
+                        if (it != flags->flags.end())
+                            value = it->second.type != Flags::Type::BOOL;
+                    }
+
+                    continue;
+                }
+
+                CommandHandler::Command *next = !positional && level ? level->find(word) : nullptr;
+
+                if (!next)
+                {
+                    positional = true;
+                    continue;
+                }
+
+                cmd = next;
+                level = cmd->children.get();
+                path.push_back(&cmd->flags);
+            }
+
+            auto it = cmd ? levels.find(cmd) : levels.end();
+
+            if (it == levels.end() || (positional && !prefix.starts_with('-')))
+                return words;
+
+            return it->second;
+        }
+
+        void render()
+        {
+            std::string line = "\r";
+            size_t column;
+
+            if (searching)
+            {
+                std::string head = "(reverse-i-search)`" + utf8(query) + "': ";
+
+                line += head + utf8(buff);
+                column = head.size() + buff.size();
+            }
+            else
+            {
+                line += prompt + utf8(buff);
+                column = from_utf8(prompt).size() + cursor;
+            }
+
+            line += eraseLine(0) + cursorHorizontal((int)column + 1);
+
+            put(line);
+        }
+
+        static void put(const std::string& str)
+        {
+            size_t done = 0;
+
+            while (done < str.size())
+            {
+                ssize_t n = ::write(STDOUT_FILENO, str.data() + done, str.size() - done);
+
+                if (n > 0)
+                {
+                    done += n;
+                    continue;
+                }
+
+                if (n < 0 && errno == EINTR)
+                    continue;
+
+                // stdout can be non blocking when something else set it, wait until it takes more instead of dropping the rest
+                if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                {
+                    pollfd out{ STDOUT_FILENO, POLLOUT, 0 };
+
+                    if (poll(&out, 1, -1) >= 0 || errno == EINTR)
+                        continue;
+                }
+
+                return;
+            }
+        }
+
+        void add_history(const std::string& line)
+        {
+            if (line.empty() || (!history.empty() && history.back() == line))
+                return;
+
+            history.push_back(line);
+
+            if (history_path.empty())
+                return;
+
+            // a single O_APPEND write so lines from concurrent sessions never mix
+            int fd = open(history_path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+
+            if (fd < 0)
+                return;
+
+            std::string entry = line + '\n';
+            (void)::write(fd, entry.data(), entry.size());
+
+            close(fd);
+        }
+
+        void load_history()
+        {
+            if (history_path.empty())
+                return;
+
+            int fd = open(history_path.c_str(), O_RDONLY | O_CLOEXEC);
+
+            if (fd < 0)
+                return;
+
+            std::string data;
+            char chunk[8192];
+            ssize_t n;
+
+            while ((n = ::read(fd, chunk, sizeof(chunk))) > 0)
+                data.append(chunk, n);
+
+            close(fd);
+
+            size_t start = 0;
+
+            for (size_t nl; (nl = data.find('\n', start)) != std::string::npos; start = nl + 1)
+            {
+                if (nl > start)
+                    history.emplace_back(data, start, nl - start);
+            }
+        }
+
+        static std::string utf8(const std::u32string& str)
+        {
+            std::string result;
+            result.reserve(str.size());
+
+            for (char32_t c : str)
+            {
+                if (c < 0x80)
+                    result += (char)c;
+                else if (c < 0x800)
+                {
+                    result += (char)(0xc0 | (c >> 6));
+                    result += (char)(0x80 | (c & 0x3f));
+                }
+                else if (c < 0x10000)
+                {
+                    result += (char)(0xe0 | (c >> 12));
+                    result += (char)(0x80 | ((c >> 6) & 0x3f));
+                    result += (char)(0x80 | (c & 0x3f));
+                }
+                else
+                {
+                    result += (char)(0xf0 | (c >> 18));
+                    result += (char)(0x80 | ((c >> 12) & 0x3f));
+                    result += (char)(0x80 | ((c >> 6) & 0x3f));
+                    result += (char)(0x80 | (c & 0x3f));
+                }
+            }
+
+            return result;
+        }
+
+        static std::u32string from_utf8(std::string_view str)
+        {
+            std::u32string result;
+            result.reserve(str.size());
+
+            for (size_t i = 0; i < str.size();)
+            {
+                unsigned char c = str[i];
+                size_t len = c < 0x80 ? 1 : (c >> 5) == 0x6 ? 2 : (c >> 4) == 0xe ? 3 : (c >> 3) == 0x1e ? 4 : 1;
+
+                if (i + len > str.size())
+                    len = 1;
+
+                char32_t cp = len == 1 ? c : c & (0x7f >> len);
+
+                for (size_t j = 1; j < len; j++)
+                    cp = (cp << 6) | ((unsigned char)str[i + j] & 0x3f);
+
+                result += cp;
+                i += len;
+            }
+
+            return result;
+        }
+	};
+}
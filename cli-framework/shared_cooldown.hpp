@@ -0,0 +1,368 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <thread>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace cli
+{
+	// cooldowns and rate limits shared by every process on the host through a memory mapped file.
+	// each key owns a slot in an open addressed table that is only updated with atomic compare and swap on
+	// CLOCK_MONOTONIC timestamps, so there are no locks a crashed process could leave held.
+	// slots whose window has passed are reused by new keys, and a slot a process died in the middle of reusing is
+	// taken over again once it is older than a second.
+	//
+	// set it as the backend of a handler with: handler.cooldown_backend = std::ref(shared);
+	class SharedCooldowns
+	{
+	public:
+
+        explicit SharedCooldowns(const std::string& path, uint32_t slots = 4096)
+        {
+            fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+
+            if (fd < 0)
+                return;
+
+            // the lock is only held while the table is set up, never while it is used
+            flock(fd, LOCK_EX);
+
+            struct stat st{};
+            fstat(fd, &st);
+
+            Header existing{};
+
+            if ((size_t)st.st_size >= sizeof(Header))
+                (void)pread(fd, &existing, sizeof(existing), 0);
+
+            if (existing.magic == magic && existing.version == version && (size_t)st.st_size >= bytes(existing.slots))
+                slots = existing.slots;
+            else
+            {
+                Header header{ magic, version, slots, 0 };
+
+                if (ftruncate(fd, 0) != 0 || ftruncate(fd, (off_t)bytes(slots)) != 0 ||
+                    pwrite(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header))
+                {
+                    flock(fd, LOCK_UN);
+                    return;
+                }
+            }
+
+            size = bytes(slots);
+            void *map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+            flock(fd, LOCK_UN);
+
+            if (map == MAP_FAILED)
+                return;
+
+            header = (Header*)map;
+            table = (Slot*)((char*)map + sizeof(Header));
+        }
+
+        SharedCooldowns(const SharedCooldowns&) = delete;
+        SharedCooldowns& operator=(const SharedCooldowns&) = delete;
+
+        ~SharedCooldowns()
+        {
+            if (header)
+                munmap(header, size);
+
+            if (fd >= 0)
+                close(fd);
+        }
+
+        // false if the file could not be opened or mapped, acquire then always succeeds
+        bool ok() const
+        {
+            return header != nullptr;
+        }
+
+        // takes one of limit uses of key in the current window and returns false if they are all used up.
+        // a window starts at the first use after the previous one ended.
+        // if the table is full of keys that are still active it fails open and returns true
+        bool acquire(std::string_view key, std::chrono::milliseconds window, uint32_t limit = 1)
+        {
+            if (!header || limit == 0)
+                return limit != 0;
+
+            if (limit >= reclaiming)
+                limit = reclaiming - 1;
+
+            uint64_t hash = hash_key(key);
+
+            for (int attempt = 0;; attempt++)
+            {
+                uint64_t now = now_ms();
+                bool busy = false;
+                Slot *slot = find(hash, now, (uint64_t)window.count(), busy);
+
+                if (!slot && !busy)
+                    return true;
+
+                if (slot)
+                {
+                    switch (take(*slot, hash, now, (uint64_t)window.count(), limit))
+                    {
+                        case Take::ok:      return true;
+                        case Take::limited: return false;
+                        case Take::retry:   break;
+                    }
+                }
+
+                back_off(attempt);
+            }
+        }
+
+        // the signature CommandHandler::cooldown_backend expects
+        bool operator()(std::string_view key, std::chrono::milliseconds cooldown)
+        {
+            return acquire(key, cooldown, 1);
+        }
+
+        // frees slots left behind by processes that died while claiming them and returns how many slots can be reused.
+        // it never has to run, acquire does the same work lazily
+        size_t cleanup()
+        {
+            if (!header)
+                return 0;
+
+            uint64_t now = now_ms();
+            size_t reusable = 0;
+
+            for (uint32_t i = 0; i < header->slots; i++)
+            {
+                Slot &slot = table[i];
+                uint64_t state = slot.state.load();
+
+                if (count(state) == reclaiming && stale(state, now))
+                    slot.state.compare_exchange_strong(state, pack(start(state), 0));
+
+                if (slot.key.load() == 0 || expired(slot, slot.state.load(), now))
+                    reusable++;
+            }
+
+            return reusable;
+        }
+
+	private:
+
+        static constexpr uint64_t magic = 0x434c49434f4f4c44; // CLICOOLD
+        static constexpr uint32_t version = 2;
+
+        // a count of this value marks a slot that is being handed to a key, its time is when that started
+        static constexpr uint64_t reclaiming = 0xffff;
+        static constexpr uint64_t stale_ms = 1000;
+
+        static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared cooldowns need lock free 64 bit atomics");
+
+        struct Header
+        {
+            uint64_t magic;
+            uint32_t version;
+            uint32_t slots;
+            uint64_t reserved;
+        };
+
+        // state packs the start of the window in milliseconds in the upper 48 bits and the uses in the lower 16,
+        // so one compare and swap moves both. a state of 0 only exists in slots that were never used, a slot handed to a key
+        // gets the time it was claimed with no uses, so no state can ever come back to a value another process read before
+        struct Slot
+        {
+            std::atomic<uint64_t> key;
+            std::atomic<uint64_t> state;
+            std::atomic<uint64_t> window;
+            uint64_t reserved;
+        };
+
+        enum class Take
+        {
+            ok,
+            limited,
+            retry
+        };
+
+        int fd = -1;
+        size_t size = 0;
+        Header *header = nullptr;
+        Slot *table = nullptr;
+
+        static size_t bytes(uint32_t slots)
+        {
+            return sizeof(Header) + sizeof(Slot) * (size_t)slots;
+        }
+
+        static uint64_t now_ms()
+        {
+            timespec ts{};
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+
+            // never 0 so a started window can not be mistaken for an empty state
+            return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000 + 1;
+        }
+
+        static uint64_t hash_key(std::string_view key)
+        {
+            uint64_t hash = 0xcbf29ce484222325;
+
+            for (char c : key)
+            {
+                hash ^= (unsigned char)c;
+                hash *= 0x100000001b3;
+            }
+
+            return hash == 0 ? 1 : hash;
+        }
+
+        static uint64_t pack(uint64_t start, uint64_t uses)
+        {
+            return (start << 16) | uses;
+        }
+
+        static uint64_t start(uint64_t state)
+        {
+            return state >> 16;
+        }
+
+        static uint64_t count(uint64_t state)
+        {
+            return state & 0xffff;
+        }
+
+        // a start in the future comes from before a reboot since the monotonic clock restarts with the machine
+        static bool stale(uint64_t state, uint64_t now)
+        {
+            return start(state) > now || now > start(state) + stale_ms;
+        }
+
+        // a slot that is being claimed or was claimed and never used belongs to a process that is about to use it,
+        // it only counts as expired once that process must have died
+        static bool expired(const Slot& slot, uint64_t state, uint64_t now)
+        {
+            if (count(state) == reclaiming || count(state) == 0)
+                return stale(state, now);
+
+            return start(state) > now || now - start(state) >= slot.window.load();
+        }
+
+        // another process is in the middle of handing a slot to a key. it takes microseconds unless that process died,
+        // then the slot only frees up after stale_ms, so after a few quick retries this sleeps instead of spinning
+        static void back_off(int attempt)
+        {
+            if (attempt < 8)
+            {
+                std::this_thread::yield();
+                return;
+            }
+
+            std::this_thread::sleep_for(std::chrono::microseconds(std::min(50 << std::min(attempt - 8, 7), 5000)));
+        }
+
+        // linear probing. keys are never removed, only replaced, so a chain never has holes and the first empty slot
+        // means the key is not in the table. a new key prefers an expired slot over an empty one to keep chains short.
+        // a slot that is being handed to a key could be getting this very key, so the lookup stops and sets busy
+        // instead of probing past it and giving the key a second slot.
+        // the state is read before the key, a claim writes the key before the state so a claimed state is never seen with the old key
+        Slot* find(uint64_t hash, uint64_t now, uint64_t window, bool& busy)
+        {
+            uint32_t slots = header->slots;
+            Slot *reuse = nullptr;
+            uint64_t reuse_state = 0;
+
+            for (uint32_t probe = 0; probe < slots; probe++)
+            {
+                Slot &slot = table[(hash + probe) % slots];
+                uint64_t state = slot.state.load();
+                uint64_t key = slot.key.load();
+
+                if (key == hash)
+                    return &slot;
+
+                if (count(state) == reclaiming && !stale(state, now))
+                {
+                    busy = true;
+                    return nullptr;
+                }
+
+                if (key == 0)
+                {
+                    if (!reuse)
+                    {
+                        reuse = &slot;
+                        reuse_state = state;
+                    }
+
+                    break;
+                }
+
+                if (!reuse && expired(slot, state, now))
+                {
+                    reuse = &slot;
+                    reuse_state = state;
+                }
+            }
+
+            if (!reuse)
+                return nullptr;
+
+            // empty and expired slots are claimed the same way. marking the slot first makes every process
+            // still using the old key retry its lookup, and every process after the same key wait for the claim
+            if (!reuse->state.compare_exchange_strong(reuse_state, pack(now, reclaiming)))
+                return find(hash, now, window, busy);
+
+            reuse->key.store(hash);
+            reuse->window.store(window);
+            reuse->state.store(pack(now, 0));
+
+            return reuse;
+        }
+
+        Take take(Slot& slot, uint64_t hash, uint64_t now, uint64_t window, uint64_t limit)
+        {
+            while (true)
+            {
+                uint64_t state = slot.state.load();
+
+                if (slot.key.load() != hash)
+                    return Take::retry;
+
+                uint64_t next;
+
+                if (count(state) == reclaiming)
+                {
+                    if (!stale(state, now))
+                        return Take::retry;
+
+                    next = pack(now, 1);
+                }
+                else if (count(state) == 0 || start(state) > now || now - start(state) >= window)
+                    next = pack(now, 1);
+                else if (count(state) < limit)
+                    next = pack(start(state), count(state) + 1);
+                else
+                    return Take::limited;
+
+                if (!slot.state.compare_exchange_weak(state, next))
+                    continue;
+
+                // only written once the slot is known to still be this key's, a key whose window changed updates it here
+                if (slot.window.load() != window && slot.key.load() == hash)
+                    slot.window.store(window);
+
+                return Take::ok;
+            }
+        }
+	};
+}
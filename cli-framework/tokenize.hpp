@@ -0,0 +1,277 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace cli
+{
+	// the words of a line split like a POSIX shell would. plain words and words made of a single quoted part are views
+	// into the line so it has to outlive the tokens, words that needed quotes or escapes joined or removed are copied
+	class Tokens
+	{
+	public:
+
+        Tokens() = default;
+
+        Tokens(Tokens&&) = default;
+        Tokens& operator=(Tokens&&) = default;
+
+        // copying would leave the copied views pointing at the storage of the original
+        Tokens(const Tokens&) = delete;
+        Tokens& operator=(const Tokens&) = delete;
+
+        std::vector<std::string_view> words;
+
+        // the indices of the words that are a "|" operator. a quoted or escaped "|" is a plain word and not in here
+        std::vector<size_t> operators;
+
+        // set on an unterminated quote or a trailing backslash, the words before it are still there
+        const char* error = nullptr;
+
+        size_t size() const                         { return words.size(); }
+        bool empty() const                          { return words.empty(); }
+        std::string_view operator[](size_t i) const { return words[i]; }
+        auto begin() const                          { return words.begin(); }
+        auto end() const                            { return words.end(); }
+
+        // copies the words into the argument type commands take
+        std::vector<std::string> args() const
+        {
+            return { words.begin(), words.end() };
+        }
+
+	private:
+
+        // heap blocks never move so the views into them survive moving the tokens
+        std::vector<std::unique_ptr<char[]>> storage;
+
+        friend Tokens tokenize(std::string_view line);
+
+        std::string_view keep(const std::string& word)
+        {
+            auto &block = storage.emplace_back(std::make_unique<char[]>(word.size()));
+            std::memcpy(block.get(), word.data(), word.size());
+
+            return { block.get(), word.size() };
+        }
+	};
+
+	namespace detail
+	{
+		// finds the first of the given bytes at or after i, 16 bytes at a time where SSE2 is available
+		template<char... Cs>
+		inline size_t find_any(std::string_view str, size_t i)
+		{
+			const char *data = str.data();
+			size_t size = str.size();
+
+#ifdef __SSE2__
+			for (; i + 16 <= size; i += 16)
+			{
+				__m128i chunk = _mm_loadu_si128((const __m128i*)(data + i));
+				__m128i hits = _mm_setzero_si128();
+
+				((hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, _mm_set1_epi8(Cs)))), ...);
+
+				int mask = _mm_movemask_epi8(hits);
+
+				if (mask != 0)
+					return i + __builtin_ctz(mask);
+			}
+#endif
+			for (; i < size; i++)
+			{
+				if (((data[i] == Cs) || ...))
+					return i;
+			}
+
+			return size;
+		}
+
+		inline bool is_blank(char c)
+		{
+			return c == ' ' || c == '\t' || c == '\n';
+		}
+
+		// collects the parts of one word. a single part stays a view into the line, only a second part forces a copy
+		struct Word
+		{
+			std::string_view view;
+			std::string joined;
+			bool copied = false;
+			bool quoted = false;
+
+			// a word made of nothing but line continuations is no word at all, while '' or "" is an empty one
+			bool exists() const
+			{
+				return copied || quoted || !view.empty();
+			}
+
+			void add(std::string_view part)
+			{
+				if (part.empty())
+					return;
+
+				if (!copied && view.empty())
+				{
+					view = part;
+					return;
+				}
+
+				if (!copied)
+				{
+					joined.assign(view);
+					copied = true;
+				}
+
+				joined.append(part);
+			}
+		};
+	}
+
+	// splits a line into words following POSIX shell quoting:
+	// blanks seperate words, '...' keeps everything literally, "..." keeps everything but \$ \` \" \\ and \newline,
+	// a backslash outside quotes escapes the next character, backslash newline joins lines and
+	// a # at the start of a word comments out the rest of the line. parts next to each other form one word, e.g. a'b'"c" is abc.
+	// an unquoted | is a word of its own even without blanks around it and is listed in Tokens::operators
+	inline Tokens tokenize(std::string_view line)
+	{
+		using detail::find_any;
+		using detail::is_blank;
+
+		Tokens tokens;
+		size_t size = line.size();
+		size_t i = 0;
+
+		while (true)
+		{
+			while (i < size && is_blank(line[i]))
+				i++;
+
+			if (i == size)
+				break;
+
+			if (line[i] == '|')
+			{
+				tokens.operators.push_back(tokens.words.size());
+				tokens.words.push_back(line.substr(i, 1));
+				i++;
+				continue;
+			}
+
+			if (line[i] == '#')
+			{
+				i = line.find('\n', i);
+
+				if (i == std::string_view::npos)
+					break;
+
+				continue;
+			}
+
+			size_t end = find_any<' ', '\t', '\n', '\'', '"', '\\', '|'>(line, i);
+
+			// the common case, a word without quotes or escapes
+			if (end == size || is_blank(line[end]) || line[end] == '|')
+			{
+				tokens.words.push_back(line.substr(i, end - i));
+				i = end;
+				continue;
+			}
+
+			detail::Word word;
+			word.add(line.substr(i, end - i));
+			i = end;
+
+			while (i < size && !is_blank(line[i]) && line[i] != '|')
+			{
+				char c = line[i];
+
+				if (c == '\\')
+				{
+					if (i + 1 == size)
+					{
+						tokens.error = "trailing backslash";
+						return tokens;
+					}
+
+					// backslash newline is a line continuation and disappears
+					if (line[i + 1] != '\n')
+						word.add(line.substr(i + 1, 1));
+
+					i += 2;
+				}
+				else if (c == '\'')
+				{
+					size_t close = line.find('\'', i + 1);
+
+					if (close == std::string_view::npos)
+					{
+						tokens.error = "unterminated single quote";
+						return tokens;
+					}
+
+					word.add(line.substr(i + 1, close - i - 1));
+					word.quoted = true;
+					i = close + 1;
+				}
+				else if (c == '"')
+				{
+					word.quoted = true;
+					i++;
+
+					while (true)
+					{
+						size_t stop = find_any<'"', '\\'>(line, i);
+
+						if (stop == size)
+						{
+							tokens.error = "unterminated double quote";
+							return tokens;
+						}
+
+						word.add(line.substr(i, stop - i));
+						i = stop + 1;
+
+						if (line[stop] == '"')
+							break;
+
+						if (i == size)
+						{
+							tokens.error = "unterminated double quote";
+							return tokens;
+						}
+
+						char next = line[i];
+
+						// inside double quotes a backslash only escapes these, otherwise it stays
+						if (next == '$' || next == '`' || next == '"' || next == '\\')
+							word.add(line.substr(i, 1));
+						else if (next != '\n')
+							word.add(line.substr(stop, 2));
+
+						i++;
+					}
+				}
+				else
+				{
+					end = find_any<' ', '\t', '\n', '\'', '"', '\\', '|'>(line, i);
+					word.add(line.substr(i, end - i));
+					i = end;
+				}
+			}
+
+			if (word.exists())
+				tokens.words.push_back(word.copied ? tokens.keep(word.joined) : word.view);
+		}
+
+		return tokens;
+	}
+}
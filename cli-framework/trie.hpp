@@ -0,0 +1,165 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <optional>
+#include <algorithm>
+#include <cstdint>
+
+namespace cli
+{
+	// a prefix tree over strings. nodes live in one vector and children are kept sorted,
+	// so a lookup costs the length of the key no matter how many keys there are
+	template<typename T>
+	class Trie
+	{
+	public:
+
+        Trie()
+        {
+            nodes.emplace_back();
+        }
+
+        // inserts or replaces the value stored at key
+        void insert(std::string_view key, T value)
+        {
+            uint32_t node = 0;
+
+            for (char c : key)
+            {
+                auto &children = nodes[node].children;
+                auto it = std::lower_bound(children.begin(), children.end(), c, less);
+
+                if (it != children.end() && it->first == c)
+                {
+                    node = it->second;
+                    continue;
+                }
+
+                auto child = (uint32_t)nodes.size();
+
+                children.insert(it, {c, child});
+                nodes.emplace_back();
+
+                node = child;
+            }
+
+            if (!nodes[node].value)
+                count++;
+
+            nodes[node].value = std::move(value);
+        }
+
+        // returns the value stored at key or a nullptr
+        T* find(std::string_view key)
+        {
+            auto node = walk(key);
+
+            if (!node || !nodes[*node].value)
+                return nullptr;
+
+            return &*nodes[*node].value;
+        }
+
+        // appends up to limit keys starting with prefix in sorted order
+        void complete(std::string_view prefix, std::vector<std::string>& out, size_t limit = SIZE_MAX)
+        {
+            auto node = walk(prefix);
+
+            if (!node)
+                return;
+
+            std::string key(prefix);
+            collect(*node, key, out, limit);
+        }
+
+        // returns how far prefix can be extended while every key that starts with it still matches
+        std::string extend(std::string_view prefix)
+        {
+            std::string result(prefix);
+            auto node = walk(prefix);
+
+            if (!node)
+                return result;
+
+            while (!nodes[*node].value && nodes[*node].children.size() == 1)
+            {
+                auto [c, child] = nodes[*node].children[0];
+
+                result += c;
+                *node = child;
+            }
+
+            return result;
+        }
+
+        size_t size() const
+        {
+            return count;
+        }
+
+        void clear()
+        {
+            nodes.clear();
+            nodes.emplace_back();
+            count = 0;
+        }
+
+	private:
+
+        struct Node
+        {
+            std::vector<std::pair<char, uint32_t>> children;
+            std::optional<T> value;
+        };
+
+        std::vector<Node> nodes;
+        size_t count = 0;
+
+        static bool less(const std::pair<char, uint32_t>& child, char c)
+        {
+            return child.first < c;
+        }
+
+        std::optional<uint32_t> walk(std::string_view key) const
+        {
+            uint32_t node = 0;
+
+            for (char c : key)
+            {
+                auto &children = nodes[node].children;
+                auto it = std::lower_bound(children.begin(), children.end(), c, less);
+
+                if (it == children.end() || it->first != c)
+                    return std::nullopt;
+
+                node = it->second;
+            }
+
+            return node;
+        }
+
+        void collect(uint32_t node, std::string& key, std::vector<std::string>& out, size_t& limit)
+        {
+            if (limit == 0)
+                return;
+
+            if (nodes[node].value)
+            {
+                out.push_back(key);
+                limit--;
+            }
+
+            for (auto [c, child] : nodes[node].children)
+            {
+                key += c;
+                collect(child, key, out, limit);
+                key.pop_back();
+
+                if (limit == 0)
+                    return;
+            }
+        }
+	};
+}
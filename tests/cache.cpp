@@ -0,0 +1,214 @@
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <filesystem>
+#include "../cli-framework/disk_cache.hpp"
+#include "../cli-framework/command.hpp"
+#include "check.hpp"
+
+using namespace std::chrono;
+using Args = cli::CommandHandler::Args;
+
+static size_t files(const std::string& dir)
+{
+	size_t count = 0;
+	std::error_code ec;
+
+	for (const auto &file : std::filesystem::directory_iterator(dir, ec))
+		count += file.is_regular_file();
+
+	return count;
+}
+
+int main()
+{
+	std::string dir = "/tmp/cli-cache-test-" + std::to_string(getpid());
+
+	// ==================================================
+	// hits, expiry and least recently used eviction
+
+	{
+		cli::ResultCache cache(30, 1);
+
+		CHECK(!cache.get("a"));
+
+		// every entry costs its key and value size, 10 bytes here
+		cache.put("a", "123456789", seconds(60));
+		cache.put("b", "123456789", seconds(60));
+		cache.put("c", "123456789", seconds(60));
+
+		CHECK(cache.get("a") && *cache.get("a") == "123456789");
+
+		cache.put("d", "123456789", seconds(60));
+
+		CHECK(cache.get("a") && cache.get("c") && cache.get("d"));
+		CHECK(!cache.get("b"));
+
+		// an entry over the limit on its own still stays until the next one
+		cache.put("big", std::string(100, 'x'), seconds(60));
+
+		CHECK(cache.get("big") && cache.get("big")->size() == 100);
+		CHECK(!cache.get("a"));
+
+		cache.put("short", "x", milliseconds(20));
+		CHECK(cache.get("short"));
+
+		std::this_thread::sleep_for(milliseconds(40));
+		CHECK(!cache.get("short"));
+
+		cache.clear();
+		CHECK(!cache.get("big"));
+
+		CHECK(cli::ResultCache::make_key("a", { "bc" }) != cli::ResultCache::make_key("ab", { "c" }));
+		CHECK(cli::ResultCache::make_key("a", { "b", "c" }) != cli::ResultCache::make_key("a", { "b c" }));
+	}
+
+	// ==================================================
+	// the disk tier survives the memory tier and is shared by separate caches
+
+	{
+		cli::DiskCache disk(dir);
+
+		std::string value;
+		milliseconds ttl{};
+
+		CHECK(!disk.load("missing", value, ttl));
+
+		disk.store("key", std::string("binary\0value", 12), seconds(60));
+
+		CHECK(disk.load("key", value, ttl));
+		CHECK(value == std::string("binary\0value", 12));
+		CHECK(ttl > seconds(50) && ttl <= seconds(60));
+
+		cli::ResultCache first(1024), second(1024);
+
+		disk.attach(first);
+		disk.attach(second);
+
+		first.put("shared", "output", seconds(60));
+
+		auto hit = second.get("shared");
+		CHECK(hit && *hit == "output");
+
+		// a hit from disk is kept in memory with what is left of its ttl
+		std::filesystem::remove_all(dir);
+		CHECK(second.get("shared"));
+	}
+
+	// ==================================================
+	// expired entries are never returned and only prune removes them
+
+	{
+		cli::DiskCache disk(dir);
+
+		std::string value;
+		milliseconds ttl{};
+
+		disk.store("old", "value", milliseconds(1));
+		disk.store("fresh", "value", seconds(60));
+
+		// a temporary file of a process that died while writing, from long ago
+		std::string tmp = dir + "/0000000000000000.tmp.1.1";
+		std::ofstream(tmp) << "partial";
+		std::filesystem::last_write_time(tmp, std::filesystem::file_time_type::clock::now() - minutes(5));
+
+		std::this_thread::sleep_for(milliseconds(20));
+
+		CHECK(!disk.load("old", value, ttl));
+		CHECK(files(dir) == 3);
+
+		disk.prune();
+
+		CHECK(files(dir) == 1);
+		CHECK(disk.load("fresh", value, ttl) && value == "value");
+
+		// an expired entry replaced by a fresh one is the fresh one, which prune keeps
+		disk.store("fresh", "newer", seconds(60));
+		disk.prune();
+
+		CHECK(disk.load("fresh", value, ttl) && value == "newer");
+
+		// garbage in an entry file is a miss and not a crash
+		for (const auto &file : std::filesystem::directory_iterator(dir))
+			std::ofstream(file.path()) << "not an entry";
+
+		CHECK(!disk.load("fresh", value, ttl));
+
+		std::filesystem::remove_all(dir);
+	}
+
+	// ==================================================
+	// the handler replays cached output per set of arguments
+
+	{
+		cli::CommandHandler handler;
+		handler.cache = std::make_shared<cli::ResultCache>();
+
+		int calls = 0;
+
+		handler.cmds["square"] = { {}, "squares a number", 0, nullptr, [&](Args args, std::ostream& os)
+		{
+			calls++;
+			os << std::stoi(args[0]) * std::stoi(args[0]) << '\n';
+		}, 60000 };
+
+		int execs = 0;
+		handler.cmds["exec"] = { {}, "exec only", 0, [&](Args) { execs++; }, nullptr, 60000 };
+
+		std::ostringstream os;
+		Args three = { "3" }, four = { "4" };
+
+		CHECK(handler.run("square", three, os).ok);
+		CHECK(handler.run("square", three, os).ok);
+		CHECK(handler.run("square", four, os).ok);
+
+		CHECK(os.str() == "9\n9\n16\n");
+		CHECK(calls == 2);
+
+		std::ostringstream fanned;
+
+		CHECK(handler.fan_out("square", std::vector<Args>{ { "3" }, { "4" }, { "5" } }, fanned).ok);
+		CHECK(fanned.str() == "9\n16\n25\n");
+		CHECK(calls == 3);
+
+		// flags are part of the key even though lookup takes them out of the arguments
+		bool upper = false;
+
+		auto &fmt = handler.cmds["fmt"];
+
+		fmt.description = "prints its argument";
+		fmt.cache_ttl = 60000;
+		fmt.flags.set(upper, "u", "uppercase");
+		fmt.write = [&](Args args, std::ostream& os)
+		{
+			calls++;
+			os << (upper ? "ABC" : args[0]) << '\n';
+		};
+
+		std::ostringstream flagged;
+		Args plain = { "abc" }, shouted = { "-u", "abc" };
+
+		CHECK(handler.run("fmt", plain, flagged).ok);
+		CHECK(handler.run("fmt", shouted, flagged).ok);
+
+		plain = { "abc" };
+		shouted = { "-u", "abc" };
+
+		CHECK(handler.run("fmt", plain, flagged).ok);
+		CHECK(handler.run("fmt", shouted, flagged).ok);
+		CHECK(handler.fan_out("fmt -u", std::vector<Args>{ { "abc" } }, flagged).ok);
+
+		CHECK(flagged.str() == "abc\nABC\nabc\nABC\nABC\n");
+		CHECK(calls == 5);
+
+		// exec only commands have no output to capture so they always run
+		Args none;
+
+		handler.run("exec", none);
+		handler.run("exec", none);
+
+		CHECK(execs == 2);
+	}
+
+	return check::done("cache");
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <iostream>
+
+// a tiny check helper for the feature tests next to main.cpp. every test is a program of its own, e.g.
+// g++ -std=c++20 -pthread tests/tokenize.cpp -o tokenize && ./tokenize
+// a failed check prints where it failed and keeps going, the exit code is the number of failed checks
+
+namespace check
+{
+	inline int failures = 0;
+
+	inline void report(bool ok, const char* expr, const char* file, int line)
+	{
+		if (ok)
+			return;
+
+		std::cerr << file << ':' << line << ": check failed: " << expr << '\n';
+		failures++;
+	}
+
+	inline int done(const char* name)
+	{
+		std::cout << name << ": " << (failures == 0 ? "ok" : "failed") << '\n';
+		return failures;
+	}
+}
+
+#define CHECK(expr) check::report(static_cast<bool>(expr), #expr, __FILE__, __LINE__)
@@ -0,0 +1,108 @@
+#include <sstream>
+#include <thread>
+#include <stdexcept>
+#include "../cli-framework/command.hpp"
+#include "check.hpp"
+
+using Args = cli::CommandHandler::Args;
+
+int main()
+{
+	using namespace std::chrono;
+
+	cli::CommandHandler handler;
+
+	// later inputs finish first so ordered output has to wait for the slow ones
+	handler.cmds["slow"] = { {}, "sleeps less for later inputs", 0, nullptr, [](Args args, std::ostream& os)
+	{
+		int n = std::stoi(args[0]);
+
+		std::this_thread::sleep_for(milliseconds(20 - n));
+		os << "start " << n << '\n' << "end " << n << '\n';
+	}};
+
+	handler.cmds["print"] = { {}, "exec only", 0, [](Args) {} };
+
+	handler.cmds["throws"] = { {}, "throws on 3", 0, nullptr, [](Args args, std::ostream& os)
+	{
+		if (args[0] == "3")
+			throw std::runtime_error("three");
+
+		os << args[0] << '\n';
+	}};
+
+	handler.cmds["limited"] = { {}, "has a cooldown", 60000, nullptr, [](Args, std::ostream& os) { os << "ran\n"; } };
+
+	std::vector<Args> inputs;
+	std::string expected;
+
+	for (int i = 0; i < 10; i++)
+	{
+		inputs.push_back({ std::to_string(i) });
+		expected += "start " + std::to_string(i) + "\nend " + std::to_string(i) + '\n';
+	}
+
+	// ==================================================
+	// ordered output is the same as running the inputs one after another
+
+	std::ostringstream ordered;
+	auto result = handler.fan_out("slow", inputs, ordered, { .threads = 4, .ordered = true });
+
+	CHECK(result.ok);
+	CHECK(ordered.str() == expected);
+
+	// ==================================================
+	// completion order still keeps the output of every task together
+
+	std::ostringstream unordered;
+	result = handler.fan_out("slow", inputs, unordered, { .threads = 4, .ordered = false });
+
+	CHECK(result.ok);
+	CHECK(unordered.str().size() == expected.size());
+
+	std::istringstream lines(unordered.str());
+	std::string start, end;
+
+	while (std::getline(lines, start) && std::getline(lines, end))
+		CHECK(start.substr(6) == end.substr(4));
+
+	// ==================================================
+	// exec only commands would print from every thread at once
+
+	std::ostringstream none;
+	result = handler.fan_out("print", inputs, none);
+
+	CHECK(!result.ok);
+	CHECK(std::string(result.message) == "command does not support fan_out");
+
+	// ==================================================
+	// a throwing task does not stop the others and is rethrown at the end
+
+	std::ostringstream partial;
+	bool thrown = false;
+
+	try
+	{
+		handler.fan_out("throws", inputs, partial, { .threads = 3 });
+	}
+	catch (const std::runtime_error& e)
+	{
+		thrown = std::string(e.what()) == "three";
+	}
+
+	CHECK(thrown);
+	CHECK(partial.str() == "0\n1\n2\n4\n5\n6\n7\n8\n9\n");
+
+	// ==================================================
+	// the cooldown applies to the fan out as a whole
+
+	std::ostringstream limited;
+
+	CHECK(handler.fan_out("limited", inputs, limited).ok);
+	CHECK(limited.str().size() == 4 * inputs.size());
+	CHECK(!handler.fan_out("limited", inputs, limited).ok);
+
+	CHECK(!handler.fan_out("missing", inputs, limited).ok);
+
+	return check::done("fan_out");
+}
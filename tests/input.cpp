@@ -0,0 +1,192 @@
+#include <string>
+#include <thread>
+#include <fcntl.h>
+#include "../cli-framework/input.hpp"
+#include "check.hpp"
+
+using cli::Key;
+
+// decodes everything written to a pipe before it is closed
+static std::vector<cli::Event> decode(const std::string& bytes)
+{
+	int fds[2];
+	CHECK(pipe(fds) == 0);
+	CHECK(write(fds[1], bytes.data(), bytes.size()) == (ssize_t)bytes.size());
+	close(fds[1]);
+
+	std::vector<cli::Event> events;
+
+	{
+		cli::Input input(fds[0]);
+
+		while (auto e = input.next())
+			events.push_back(*e);
+
+		CHECK(input.closed());
+	}
+
+	close(fds[0]);
+
+	return events;
+}
+
+static bool is(const cli::Event& e, Key key, char32_t ch = 0, bool ctrl = false, bool alt = false, bool shift = false)
+{
+	return e.key == key && e.ch == ch && e.ctrl == ctrl && e.alt == alt && e.shift == shift;
+}
+
+int main()
+{
+	// ==================================================
+	// plain keys, control keys and utf-8
+
+	using namespace std::string_literals;
+
+	auto events = decode("a\r\t\x7f\x01\x1c\x1d\x1f\x00" "\xc3\xa9\xe2\x82\xac"s);
+
+	CHECK(events.size() == 11);
+
+	if (events.size() == 11)
+	{
+		CHECK(is(events[0], Key::character, 'a'));
+		CHECK(is(events[1], Key::enter));
+		CHECK(is(events[2], Key::tab));
+		CHECK(is(events[3], Key::backspace));
+		CHECK(is(events[4], Key::character, 'a', true));
+		CHECK(is(events[5], Key::character, '\\', true));
+		CHECK(is(events[6], Key::character, ']', true));
+		CHECK(is(events[7], Key::character, '_', true));
+		CHECK(is(events[8], Key::character, '@', true));
+		CHECK(is(events[9], Key::character, U'é'));
+		CHECK(is(events[10], Key::character, U'€'));
+	}
+
+	// ==================================================
+	// escape sequences, alt and a lone escape at the end
+
+	events = decode("\x1b[A\x1bOB\x1b[1;5C\x1b[3~\x1b[15~\x1b[Z\x1bx\x1b");
+
+	CHECK(events.size() == 8);
+
+	if (events.size() == 8)
+	{
+		CHECK(is(events[0], Key::up));
+		CHECK(is(events[1], Key::down));
+		CHECK(is(events[2], Key::right, 0, true));
+		CHECK(is(events[3], Key::del));
+		CHECK(is(events[4], Key::f5));
+		CHECK(is(events[5], Key::tab, 0, false, false, true));
+		CHECK(is(events[6], Key::character, 'x', false, true));
+		CHECK(is(events[7], Key::escape));
+	}
+
+	// ==================================================
+	// mouse, SGR and legacy X10
+
+	events = decode("\x1b[<0;10;5M\x1b[<0;10;5m\x1b[<65;1;2M\x1b[M" "\x20\x2a\x25");
+
+	CHECK(events.size() == 4);
+
+	if (events.size() == 4)
+	{
+		CHECK(events[0].key == Key::mouse && events[0].button == cli::Mouse::left && events[0].column == 10 && events[0].row == 5);
+		CHECK(events[1].button == cli::Mouse::release);
+		CHECK(events[2].button == cli::Mouse::wheel_down && events[2].row == 2);
+		CHECK(events[3].button == cli::Mouse::left && events[3].column == 10 && events[3].row == 5);
+	}
+
+	// ==================================================
+	// parameters too long for an int saturate instead of overflowing
+
+	events = decode("\x1b[99999999999999A\x1b[<0;99999999999999999999;5Mz");
+
+	CHECK(events.size() == 3);
+
+	if (events.size() == 3)
+	{
+		CHECK(is(events[0], Key::up));
+		CHECK(events[1].key == Key::mouse && events[1].column == 99999 && events[1].row == 5);
+		CHECK(is(events[2], Key::character, 'z'));
+	}
+
+	// ==================================================
+	// a bracketed paste comes through whole, newlines and all
+
+	events = decode("x\x1b[200~one\ntwo\x1b[201~y");
+
+	CHECK(events.size() == 3);
+
+	if (events.size() == 3)
+	{
+		CHECK(events[1].key == Key::paste);
+		CHECK(events[1].text == "one\ntwo");
+	}
+
+	// ==================================================
+	// a paste split across reads further apart than the escape timeout is still one paste
+
+	{
+		int fds[2];
+		CHECK(pipe(fds) == 0);
+
+		std::thread writer([&]
+		{
+			std::string first = "\x1b[200~rm -rf build\nmake";
+			std::string second = " all\n\x1b[201~";
+
+			(void)!write(fds[1], first.data(), first.size());
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			(void)!write(fds[1], second.data(), second.size());
+
+			close(fds[1]);
+		});
+
+		cli::Input input(fds[0], std::chrono::milliseconds(25));
+
+		auto e = input.next();
+
+		CHECK(e && e->key == Key::paste);
+		CHECK(e && e->text == "rm -rf build\nmake all\n");
+		CHECK(!input.next());
+
+		writer.join();
+		close(fds[0]);
+	}
+
+	// ==================================================
+	// a lone escape is told apart from a sequence by the timeout
+
+	{
+		int fds[2];
+		CHECK(pipe(fds) == 0);
+
+		cli::Input input(fds[0], std::chrono::milliseconds(10));
+
+		CHECK(write(fds[1], "\x1b", 1) == 1);
+
+		auto e = input.next(1000);
+		CHECK(e && e->key == Key::escape);
+
+		// nothing there returns on timeout, and wake makes a waiting next return
+		CHECK(!input.next(10));
+
+		std::thread waker([&]
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+			input.wake();
+		});
+
+		CHECK(!input.next());
+		CHECK(!input.closed());
+
+		waker.join();
+
+		// the descriptor is never switched to non blocking, on a tty it is shared with stdout
+		CHECK((fcntl(fds[0], F_GETFL) & O_NONBLOCK) == 0);
+
+		close(fds[1]);
+		close(fds[0]);
+	}
+
+	return check::done("input");
+}
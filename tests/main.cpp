@@ -2,7 +2,6 @@
 #include "../cli-framework/framework.hpp"
 #include "vec_util.hpp"
 #include <thread>
-#include <conio.h>
 #include <cassert>
 
 
@@ -120,42 +119,51 @@ int main(int argc, const char* argv[])
 	
 
 	// ==================================================
-	// makes allows you to move around the symbol with the numb pad arrow keys
+	// makes allows you to move around the symbol with the arrow keys, escape quits.
+	// needs linux since it reads raw keys through cli::Terminal and cli::Input
 
 	/*std::string symbol = cli::color("=", cli::colors::red);
 
-	std::cout << symbol;
+	cli::Terminal terminal;
+	cli::Input input;
 
-	std::cout << cli::hide_cursor();
+	std::cout << cli::hide_cursor() << symbol << std::flush;
 
-	while (true)
+	while (auto event = input.next())
 	{
-		int ch = _getch();
+		if (event->key == cli::Key::escape)
+			break;
 
-		switch (ch)
+		switch (event->key)
 		{
-		case 54:
+		case cli::Key::right:
 				std::cout << cli::eraseLine(2);
 				std::cout << cli::cursorForward(1);
 				std::cout << symbol;
 				break;
-		case 52:
+		case cli::Key::left:
 				std::cout << cli::eraseLine(2);
 				std::cout << cli::cursorBack(2);
 				std::cout << symbol;
 				break;
-		case 50:
+		case cli::Key::down:
 				std::cout << cli::eraseLine(2);
 				std::cout << cli::cursorDown();
 				std::cout << cli::cursorBack();
 				std::cout << symbol;
 				break;
-		case 56:
+		case cli::Key::up:
 				std::cout << cli::eraseLine(2);
 				std::cout << cli::cursorUp();
 				std::cout << cli::cursorBack();
 				std::cout << symbol;
 				break;
+		default:
+				break;
 		}
-	}*/
+
+		std::cout << std::flush;
+	}
+
+	std::cout << cli::show_cursor();*/
 }  
\ No newline at end of file
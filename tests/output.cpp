@@ -0,0 +1,169 @@
+#include <string>
+#include <vector>
+#include <thread>
+#include <sstream>
+#include <fcntl.h>
+#include "../cli-framework/output.hpp"
+#include "check.hpp"
+
+// reads everything from fd until every writer closed it
+static std::string read_all(int fd)
+{
+	std::string data;
+	char buff[65536];
+
+	for (ssize_t n; (n = read(fd, buff, sizeof(buff))) > 0;)
+		data.append(buff, n);
+
+	return data;
+}
+
+int main()
+{
+	// ==================================================
+	// lines from many threads never interleave and every thread's lines stay in order
+
+	{
+		int fds[2];
+		CHECK(pipe(fds) == 0);
+
+		std::string data;
+		std::thread reader([&] { data = read_all(fds[0]); });
+
+		const int threads = 8;
+		const int lines = 5000;
+
+		{
+			// a small buffer so lines are handed off while other threads are writing
+			cli::Output out(fds[1], 256);
+			std::vector<std::thread> writers;
+
+			for (int t = 0; t < threads; t++)
+			{
+				writers.emplace_back([&out, t]
+				{
+					for (int i = 0; i < lines; i++)
+						out << "thread " << t << " line " << i << " " << std::string(t * 3, 'x') << '\n';
+				});
+			}
+
+			for (auto &w : writers)
+				w.join();
+		}
+
+		close(fds[1]);
+		reader.join();
+		close(fds[0]);
+
+		std::vector<int> next(threads, 0);
+		std::istringstream in(data);
+		std::string line;
+		int count = 0;
+
+		while (std::getline(in, line))
+		{
+			int t = -1, i = -1;
+			char rest[256] = {};
+
+			bool parsed = sscanf(line.c_str(), "thread %d line %d %255s", &t, &i, rest) >= 2 && t >= 0 && t < threads;
+			CHECK(parsed);
+
+			if (!parsed)
+				break;
+
+			CHECK(i == next[t]);
+			CHECK(std::string(rest) == std::string(t * 3, 'x'));
+
+			next[t] = i + 1;
+			count++;
+		}
+
+		CHECK(count == threads * lines);
+	}
+
+	// ==================================================
+	// a partial line is written on flush and by the destructor
+
+	{
+		int fds[2];
+		CHECK(pipe(fds) == 0);
+
+		{
+			cli::Output out(fds[1]);
+
+			out << "no newline " << 42 << ' ' << 1.5 << ' ' << true;
+			out.flush();
+
+			char buff[64] = {};
+			CHECK(read(fds[0], buff, sizeof(buff)) == 19);
+			CHECK(std::string(buff) == "no newline 42 1.5 1");
+
+			out << "left over";
+		}
+
+		close(fds[1]);
+		CHECK(read_all(fds[0]) == "left over");
+		close(fds[0]);
+	}
+
+	// ==================================================
+	// a full non blocking descriptor is waited on and nothing is lost
+
+	{
+		int fds[2];
+		CHECK(pipe(fds) == 0);
+		fcntl(fds[1], F_SETFL, O_NONBLOCK);
+
+		std::string data;
+		std::thread reader([&]
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			data = read_all(fds[0]);
+		});
+
+		std::string expected;
+
+		{
+			cli::Output out(fds[1]);
+
+			for (int i = 0; i < 100000; i++)
+			{
+				std::string line = "line " + std::to_string(i) + '\n';
+
+				out << line;
+				expected += line;
+			}
+		}
+
+		close(fds[1]);
+		reader.join();
+		close(fds[0]);
+
+		CHECK(data == expected);
+	}
+
+	// ==================================================
+	// sinks a thread wrote to and that are gone do not pile up, a new sink still gets its own buffer
+
+	{
+		int fds[2];
+		CHECK(pipe(fds) == 0);
+
+		for (int i = 0; i < 10000; i++)
+		{
+			cli::Output out(fds[1]);
+			out << "";
+		}
+
+		{
+			cli::Output out(fds[1]);
+			out << "last\n";
+		}
+
+		close(fds[1]);
+		CHECK(read_all(fds[0]) == "last\n");
+		close(fds[0]);
+	}
+
+	return check::done("output");
+}
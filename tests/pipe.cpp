@@ -0,0 +1,252 @@
+#include <string>
+#include <sstream>
+#include <thread>
+#include <stdexcept>
+#include "../cli-framework/pipe.hpp"
+#include "check.hpp"
+
+using Args = cli::CommandHandler::Args;
+
+int main()
+{
+	// ==================================================
+	// bytes come out in order across threads, in chunks that wrap around the ring
+
+	{
+		cli::Pipe pipe(4096);
+
+		const size_t total = 8 * 1024 * 1024;
+		size_t received = 0;
+		bool in_order = true;
+		bool written = true;
+
+		std::thread producer([&]
+		{
+			std::string chunk;
+
+			for (size_t sent = 0; sent < total;)
+			{
+				chunk.clear();
+
+				// odd chunk sizes so writes straddle the end of the ring
+				for (size_t i = 0; i < 1000 + sent % 777 && sent < total; i++, sent++)
+					chunk += (char)(sent % 251);
+
+				written &= pipe.write(chunk);
+			}
+
+			pipe.close();
+		});
+
+		for (std::string_view data; !(data = pipe.read()).empty();)
+		{
+			for (char c : data)
+				in_order &= c == (char)(received++ % 251);
+
+			pipe.consume(data.size());
+		}
+
+		producer.join();
+
+		CHECK(written);
+		CHECK(in_order);
+		CHECK(received == total);
+	}
+
+	// ==================================================
+	// lines, a last line without '\n' and a line longer than the pipe
+
+	{
+		cli::Pipe pipe(4096);
+
+		std::thread producer([&]
+		{
+			pipe.write("one\n\ntwo\n");
+			pipe.write(std::string(5000, 'x') + "\nlast");
+			pipe.close();
+		});
+
+		std::vector<std::string> lines;
+
+		for (std::string_view line; pipe.read_line(line);)
+			lines.emplace_back(line);
+
+		producer.join();
+
+		CHECK(lines.size() == 6);
+
+		if (lines.size() == 6)
+		{
+			CHECK(lines[0] == "one" && lines[1].empty() && lines[2] == "two");
+			CHECK(lines[3] == std::string(4096, 'x'));
+			CHECK(lines[4] == std::string(904, 'x'));
+			CHECK(lines[5] == "last");
+		}
+	}
+
+	// ==================================================
+	// a reader that stops makes the writer stop instead of blocking on a full pipe
+
+	{
+		cli::Pipe pipe(4096);
+		bool stopped = false;
+
+		std::thread producer([&]
+		{
+			while (pipe.write(std::string(1000, 'y')))
+				;
+
+			stopped = true;
+		});
+
+		std::string_view data = pipe.read();
+		CHECK(!data.empty());
+
+		pipe.close_read();
+		producer.join();
+
+		CHECK(stopped);
+		CHECK(pipe.reserve().empty());
+	}
+
+	cli::CommandHandler handler;
+
+	handler.cmds["seq"] = { {}, "prints 1 to n", 0, nullptr, [](Args args, std::ostream& os)
+	{
+		for (int i = 1; i <= std::stoi(args[0]) && os; i++)
+			os << i << '\n';
+	}};
+
+	handler.cmds["grep"] = { {}, "keeps matching lines", 0, nullptr, nullptr, 0, [](Args args, cli::Pipe& in, cli::Pipe& out)
+	{
+		for (std::string_view line; in.read_line(line);)
+		{
+			if (line.find(args[0]) != std::string_view::npos && !(out.write(line) && out.write("\n")))
+				return;
+		}
+	}};
+
+	handler.cmds["head"] = { {}, "keeps the first n lines", 0, nullptr, nullptr, 0, [](Args args, cli::Pipe& in, cli::Pipe& out)
+	{
+		int n = std::stoi(args[0]);
+
+		for (std::string_view line; n-- > 0 && in.read_line(line);)
+			out.write(std::string(line) + '\n');
+	}};
+
+	handler.cmds["limited"] = { {}, "has a cooldown", 60000, nullptr, [](Args, std::ostream& os) { os << "limited\n"; } };
+	handler.cmds["print"] = { {}, "exec only", 0, [](Args) {} };
+
+	handler.cmds["fail"] = { {}, "throws", 0, nullptr, nullptr, 0, [](Args, cli::Pipe&, cli::Pipe&)
+	{
+		throw std::runtime_error("failed");
+	}};
+
+	handler.cmds["cat"] = { {}, "copies its input, has a cooldown", 60000, nullptr, nullptr, 0, [](Args, cli::Pipe& in, cli::Pipe& out)
+	{
+		for (std::string_view line; in.read_line(line);)
+			out.write(std::string(line) + '\n');
+	}};
+
+	handler.cmds["ready"] = { {}, "has a cooldown", 60000, nullptr, [](Args, std::ostream& os) { os << "ready\n"; } };
+
+	// ==================================================
+	// stages run through pipes, write only commands work as stages
+
+	{
+		std::ostringstream os;
+
+		CHECK(cli::pipeline(handler, Args{ "seq", "100", "|", "grep", "7", "|", "head", "3" }, os, 4096).ok);
+		CHECK(os.str() == "7\n17\n27\n");
+
+		// an endless first stage is stopped by a last stage that finishes early
+		os.str("");
+
+		CHECK(cli::pipeline(handler, Args{ "seq", "100000000", "|", "head", "2" }, os, 4096).ok);
+		CHECK(os.str() == "1\n2\n");
+	}
+
+	// ==================================================
+	// nothing starts and no cooldown is used up unless every stage can run
+
+	{
+		std::ostringstream os;
+
+		auto result = cli::pipeline(handler, Args{ "limited", "|", "print" }, os);
+		CHECK(!result.ok && std::string(result.message) == "command can not be used in a pipeline");
+
+		result = cli::pipeline(handler, Args{ "limited", "|", "missing" }, os);
+		CHECK(!result.ok && std::string(result.message) == "command not found");
+
+		result = cli::pipeline(handler, Args{ "limited", "|" }, os);
+		CHECK(!result.ok && std::string(result.message) == "empty pipeline stage");
+
+		CHECK(os.str().empty());
+
+		CHECK(cli::pipeline(handler, Args{ "limited", "|", "grep", "l" }, os).ok);
+		CHECK(os.str() == "limited\n");
+
+		result = cli::pipeline(handler, Args{ "limited" }, os);
+		CHECK(!result.ok && std::string(result.message) == "command is on cooldown");
+	}
+
+	// ==================================================
+	// a command used by several stages starts its cooldown once, a stage on cooldown starts none of the others
+
+	{
+		std::ostringstream os;
+
+		CHECK(cli::pipeline(handler, Args{ "seq", "2", "|", "cat", "|", "cat" }, os).ok);
+		CHECK(os.str() == "1\n2\n");
+
+		auto result = cli::pipeline(handler, Args{ "ready", "|", "cat" }, os);
+		CHECK(!result.ok && std::string(result.message) == "command is on cooldown");
+
+		// pipes that can not be created fail before any cooldown starts
+		result = cli::pipeline(handler, Args{ "ready", "|", "grep", "r" }, os, (size_t)1 << 60);
+		CHECK(!result.ok && std::string(result.message) == "could not create pipeline");
+
+		Args args;
+		CHECK(handler.run("ready", args, os).ok);
+	}
+
+	// ==================================================
+	// only the first stage can ignore its input, pipe only commands do not run on their own
+
+	{
+		std::ostringstream os;
+
+		auto result = cli::pipeline(handler, Args{ "seq", "3", "|", "seq", "5" }, os);
+		CHECK(!result.ok && std::string(result.message) == "command is not a filter");
+
+		Args args = { "7" };
+		result = handler.run("grep", args, os);
+		CHECK(!result.ok && std::string(result.message) == "command can only be used in a pipeline");
+
+		result = handler.run("grep", args);
+		CHECK(!result.ok && std::string(result.message) == "command can only be used in a pipeline");
+
+		CHECK(os.str().empty());
+	}
+
+	// ==================================================
+	// a stage that throws is rethrown once every stage stopped
+
+	{
+		std::ostringstream os;
+		bool thrown = false;
+
+		try
+		{
+			cli::pipeline(handler, Args{ "seq", "100000", "|", "fail" }, os, 4096);
+		}
+		catch (const std::runtime_error& e)
+		{
+			thrown = std::string(e.what()) == "failed";
+		}
+
+		CHECK(thrown);
+	}
+
+	return check::done("pipe");
+}
@@ -0,0 +1,217 @@
+// this file is the test and the plugin it loads:
+// g++ -std=c++20 -shared -fPIC -DPLUGIN tests/plugin.cpp -o libplugin_test.so
+// g++ -std=c++20 -pthread tests/plugin.cpp -o plugin_test -ldl && ./plugin_test ./libplugin_test.so
+// without the library path only the failure paths are checked
+
+#include <sstream>
+#include <fstream>
+#include <cstdio>
+#include "../cli-framework/plugin.hpp"
+#include "../cli-framework/pipe.hpp"
+
+#ifdef PLUGIN
+
+extern "C" void setup_upper(cli::CommandHandler::Command& cmd)
+{
+	cmd.write = [](cli::CommandHandler::Args args, std::ostream& os)
+	{
+		for (auto &arg : args)
+		{
+			for (char c : arg)
+				os << (char)toupper((unsigned char)c);
+		}
+	};
+}
+
+extern "C" void setup_nothing(cli::CommandHandler::Command&)
+{}
+
+static int printed = 0;
+
+extern "C" int printed_count()
+{
+	return printed;
+}
+
+extern "C" void setup_print(cli::CommandHandler::Command& cmd)
+{
+	cmd.exec = [](cli::CommandHandler::Args) { printed++; };
+}
+
+static bool numbered = false;
+
+// a filter with a flag and a cache_ttl, which have to reach the installed command
+extern "C" void setup_lines(cli::CommandHandler::Command& cmd)
+{
+	cmd.cache_ttl = 1000;
+	cmd.flags.set(numbered, "n", "numbers the lines");
+	cmd.pipe = [](cli::CommandHandler::Args, cli::Pipe& in, cli::Pipe& out)
+	{
+		int n = 0;
+
+		for (std::string_view line; in.read_line(line);)
+			out.write((numbered ? std::to_string(++n) + " " : std::string()) + std::string(line) + "\n");
+	};
+}
+
+#else
+
+#include "check.hpp"
+
+static std::string manifest(const std::string& text)
+{
+	std::string path = "/tmp/cli-plugin-test-" + std::to_string(getpid()) + ".manifest";
+	std::ofstream(path) << text;
+
+	return path;
+}
+
+int main(int argc, const char* argv[])
+{
+	using Args = cli::CommandHandler::Args;
+
+	// ==================================================
+	// manifests
+
+	{
+		cli::Plugins plugins;
+
+		std::string path = manifest(
+			"# comment\n"
+			"\n"
+			"upper | up, u | 250 | ./libx.so | setup_upper | uppercases | the arguments\n");
+
+		CHECK(plugins.load(path));
+		CHECK(plugins.entries.size() == 1);
+
+		auto &e = plugins.entries.front();
+
+		CHECK(e.name == "upper");
+		CHECK((e.alias == std::vector<std::string>{ "up", "u" }));
+		CHECK(e.cooldown == 250);
+		CHECK(e.library == "./libx.so");
+		CHECK(e.symbol == "setup_upper");
+		CHECK(e.description == "uppercases | the arguments");
+
+		cli::Plugins bad;
+
+		CHECK(!bad.load(manifest("name | | x | lib.so | sym | cooldown is not a number\n")));
+		CHECK(!bad.load(manifest("name | too few fields\n")));
+		CHECK(!bad.load("/nonexistent/manifest"));
+
+		std::remove(path.c_str());
+	}
+
+	// ==================================================
+	// load failures come back as a Result and never as an exception
+
+	{
+		cli::Plugins plugins;
+
+		CHECK(plugins.load(manifest(
+			"missing | m | 0 | /nonexistent/libmissing.so | setup | missing library\n"
+			"nosym | | 0 | libc.so.6 | no_such_symbol_here | missing symbol\n")));
+
+		cli::CommandHandler handler;
+		plugins.install(handler);
+
+		// installing loads nothing, so help works for broken plugins too
+		std::ostringstream help;
+		handler.help(help);
+
+		CHECK(help.str() == "missing: missing library\nnosym: missing symbol\n");
+
+		Args args;
+		std::ostringstream os;
+
+		auto result = handler.run("m", args);
+		CHECK(!result.ok && std::string(result.message) == "failed to load plugin");
+
+		result = handler.run("nosym", args, os);
+		CHECK(!result.ok && std::string(result.message) == "failed to load plugin");
+
+		result = handler.fan_out("missing", std::vector<Args>{ {} }, os);
+		CHECK(!result.ok && std::string(result.message) == "failed to load plugin");
+	}
+
+	// ==================================================
+	// a real plugin is loaded on first use
+
+	if (argc > 1)
+	{
+		cli::Plugins plugins;
+
+		std::string lib = argv[1];
+
+		CHECK(plugins.load(manifest(
+			"upper | up | 0 | " + lib + " | setup_upper | uppercases\n"
+			"empty | | 0 | " + lib + " | setup_nothing | sets nothing up\n")));
+
+		cli::CommandHandler handler;
+		plugins.install(handler);
+
+		Args args = { "abc", "def" };
+		std::ostringstream os;
+
+		CHECK(handler.run("up", args, os).ok);
+		CHECK(os.str() == "ABCDEF");
+
+		std::ostringstream fanned;
+
+		CHECK(handler.fan_out("upper", std::vector<Args>{ {"a"}, {"b"} }, fanned).ok);
+		CHECK(fanned.str() == "AB");
+
+		CHECK(!handler.run("empty", args, os).ok);
+	}
+
+	// ==================================================
+	// the command only gets what the plugin implements, plus its flags and cache_ttl
+
+	if (argc > 1)
+	{
+		cli::Plugins plugins;
+
+		std::string lib = argv[1];
+
+		CHECK(plugins.load(manifest(
+			"upper | | 0 | " + lib + " | setup_upper | uppercases\n"
+			"print | | 0 | " + lib + " | setup_print | exec only\n"
+			"lines | | 0 | " + lib + " | setup_lines | a filter\n")));
+
+		cli::CommandHandler handler;
+		plugins.install(handler);
+
+		void *handle = dlopen(argv[1], RTLD_NOW | RTLD_NOLOAD);
+		auto printed_count = handle ? (int(*)())dlsym(handle, "printed_count") : nullptr;
+
+		// an exec only plugin can not have its output captured
+		std::ostringstream os;
+		auto result = handler.fan_out("print", std::vector<Args>{ {}, {} }, os);
+
+		CHECK(!result.ok && std::string(result.message) == "command does not support fan_out");
+		CHECK(printed_count && printed_count() == 0);
+
+		Args args;
+		CHECK(handler.run("print", args).ok);
+		CHECK(printed_count && printed_count() == 1);
+
+		result = cli::pipeline(handler, Args{ "upper", "a", "|", "print" }, os);
+		CHECK(!result.ok && std::string(result.message) == "command can not be used in a pipeline");
+
+		// a pipe only plugin works as a filter, with its flags
+		CHECK(cli::pipeline(handler, Args{ "upper", "a", "|", "lines", "-n" }, os).ok);
+		CHECK(os.str() == "1 A\n");
+
+		result = handler.run("lines", args, os);
+		CHECK(!result.ok && std::string(result.message) == "command can only be used in a pipeline");
+
+		CHECK(handler.find("lines")->cache_ttl == 1000);
+		CHECK(handler.find("lines")->flags.flags.count("-n") == 1);
+	}
+
+	std::remove(manifest("").c_str());
+
+	return check::done("plugin");
+}
+
+#endif
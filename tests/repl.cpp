@@ -0,0 +1,233 @@
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <cstdio>
+#include <cctype>
+#include <fcntl.h>
+#include <termios.h>
+#include "../cli-framework/repl.hpp"
+#include "check.hpp"
+
+using Args = cli::CommandHandler::Args;
+
+// replaces stdin with a pipe holding script so the repl reads it line by line like a non interactive session
+static void feed(const std::string& script)
+{
+	int fds[2];
+	CHECK(pipe(fds) == 0);
+	CHECK(write(fds[1], script.data(), script.size()) == (ssize_t)script.size());
+	close(fds[1]);
+
+	CHECK(dup2(fds[0], STDIN_FILENO) == STDIN_FILENO);
+	close(fds[0]);
+
+	clearerr(stdin);
+	std::cin.clear();
+}
+
+// runs repl on a terminal that already holds keys, the way an interactive session reads them
+static void type(cli::CommandHandler& handler, const std::string& keys, std::vector<std::string>& history)
+{
+	int master = posix_openpt(O_RDWR | O_NOCTTY);
+	CHECK(master >= 0 && grantpt(master) == 0 && unlockpt(master) == 0);
+
+	int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+	CHECK(slave >= 0);
+
+	// raw before the keys arrive so the line discipline passes them on as they are
+	termios raw{};
+	tcgetattr(slave, &raw);
+	cfmakeraw(&raw);
+	tcsetattr(slave, TCSANOW, &raw);
+
+	CHECK(write(master, keys.data(), keys.size()) == (ssize_t)keys.size());
+
+	int in = dup(STDIN_FILENO), out = dup(STDOUT_FILENO);
+
+	dup2(slave, STDIN_FILENO);
+	dup2(slave, STDOUT_FILENO);
+
+	{
+		std::ostringstream os;
+		cli::Repl repl(handler);
+
+		repl.complete("--global");
+		repl.run(os);
+
+		history = repl.history;
+	}
+
+	dup2(in, STDIN_FILENO);
+	dup2(out, STDOUT_FILENO);
+
+	close(in);
+	close(out);
+	close(slave);
+	close(master);
+}
+
+static std::vector<std::string> lines(const std::string& path)
+{
+	std::vector<std::string> result;
+	std::ifstream file(path);
+
+	for (std::string line; std::getline(file, line);)
+		result.push_back(line);
+
+	return result;
+}
+
+int main()
+{
+	cli::CommandHandler handler;
+
+	handler.cmds["echo"] = { {}, "prints its arguments", 0, nullptr, [](Args args, std::ostream& os)
+	{
+		for (size_t i = 0; i < args.size(); i++)
+			os << (i ? "," : "") << args[i];
+
+		os << '\n';
+	}};
+
+	handler.cmds["upper"] = { {}, "uppercases its input", 0, nullptr, nullptr, 0, [](Args, cli::Pipe& in, cli::Pipe& out)
+	{
+		for (std::string_view line; in.read_line(line);)
+		{
+			std::string upper(line);
+
+			for (char &c : upper)
+				c = (char)toupper((unsigned char)c);
+
+			out.write(upper + '\n');
+		}
+	}};
+
+	int runs = 0;
+	handler.cmds["count"] = { {}, "exec only", 0, [&](Args) { runs++; } };
+
+	std::string history = "/tmp/cli-repl-test-" + std::to_string(getpid()) + ".history";
+	std::ofstream(history) << "from before\n";
+
+	// ==================================================
+	// quotes, comments, pipelines and errors
+
+	feed(
+		"echo \"a b\" 'c' d\\ e\n"
+		"\n"
+		"# only a comment\n"
+		"echo one two | upper\n"
+		"echo \"x|y\" '|'\n"
+		"echo a|upper\n"
+		"count\n"
+		"count\n"
+		"count | upper\n"
+		"missing\n"
+		"echo \"open\n");
+
+	std::ostringstream os;
+	cli::Repl repl(handler, "> ", history);
+
+	CHECK(repl.history.size() == 1 && repl.history[0] == "from before");
+
+	repl.run(os);
+
+	CHECK(os.str() ==
+		"a b,c,d e\n"
+		"ONE,TWO\n"
+		"x|y,|\n"
+		"A\n"
+		"command can not be used in a pipeline\n"
+		"command not found\n"
+		"unterminated double quote\n");
+
+	CHECK(runs == 2);
+
+	// ==================================================
+	// history keeps every line but empty ones and repeats, the file is appended to
+
+	std::vector<std::string> expected = {
+		"from before",
+		"echo \"a b\" 'c' d\\ e",
+		"# only a comment",
+		"echo one two | upper",
+		"echo \"x|y\" '|'",
+		"echo a|upper",
+		"count",
+		"count | upper",
+		"missing",
+		"echo \"open"
+	};
+
+	CHECK(repl.history == expected);
+	CHECK(lines(history) == expected);
+
+	// a second session starts with the history of the first
+	feed("echo again\n");
+
+	std::ostringstream again;
+	cli::Repl second(handler, "> ", history);
+
+	CHECK(second.history == expected);
+
+	second.run(again);
+
+	CHECK(again.str() == "again\n");
+	CHECK(lines(history).size() == expected.size() + 1);
+
+	std::remove(history.c_str());
+
+	// ==================================================
+	// tab completes the subcommands and flags of the command path
+
+	{
+		cli::CommandHandler completing;
+
+		bool verbose = false, fetch = false, upper = false;
+		std::string name;
+
+		auto &remote = completing.cmds["remote"];
+
+		remote.description = "manages remotes";
+		remote.flags.set(verbose, "v", "verbose output");
+
+		auto &add = remote.sub().cmds["add"];
+
+		add.alias = { "a" };
+		add.description = "adds a remote";
+		add.exec = [](Args) {};
+		add.flags.set(fetch, "f", "fetches after adding").set(name, "name", "name of the remote");
+
+		remote.sub().cmds["show"] = { {}, "shows a remote", 0, [](Args) {} };
+
+		completing.cmds["fmt"] = { {}, "prints its arguments", 0, [](Args) {} };
+		completing.cmds["fmt"].flags.set(upper, "u", "uppercase");
+
+		std::vector<std::string> typed;
+
+		type(completing,
+			"fm\t-u\t\r"
+			"fmt -v\t\r"
+			"remote ad\t-na\t\r"
+			"remote add origin -v\t\r"
+			"remote add origin o\t\r"
+			"remote -v sh\t\r"
+			"remote add -name sh\t\r"
+			"remote -- sh\t\r"
+			"fmt --gl\t\r"
+			"\x04", typed);
+
+		CHECK((typed == std::vector<std::string>{
+			"fmt -u ",
+			"fmt -v",
+			"remote add -name ",
+			"remote add origin -v ",
+			"remote add origin o",
+			"remote -v show ",
+			"remote add -name sh",
+			"remote -- sh",
+			"fmt --global "
+		}));
+	}
+
+	return check::done("repl");
+}
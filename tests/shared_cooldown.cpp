@@ -0,0 +1,220 @@
+#include <string>
+#include <cstdio>
+#include <ctime>
+#include <sys/wait.h>
+#include "../cli-framework/shared_cooldown.hpp"
+#include "../cli-framework/command.hpp"
+#include "check.hpp"
+
+using namespace std::chrono;
+
+static std::string table_path(const char* name)
+{
+	return "/tmp/cli-cooldown-test-" + std::to_string(getpid()) + '-' + name;
+}
+
+int main()
+{
+	// ==================================================
+	// limits per key and windows that end
+
+	{
+		std::string path = table_path("limits");
+		cli::SharedCooldowns cooldowns(path);
+
+		CHECK(cooldowns.ok());
+
+		for (int i = 0; i < 3; i++)
+			CHECK(cooldowns.acquire("api", milliseconds(100), 3));
+
+		CHECK(!cooldowns.acquire("api", milliseconds(100), 3));
+		CHECK(cooldowns.acquire("other", milliseconds(100), 3));
+
+		std::this_thread::sleep_for(milliseconds(150));
+
+		CHECK(cooldowns.acquire("api", milliseconds(100), 3));
+		CHECK(!cooldowns.acquire("api", milliseconds(100), 0));
+
+		std::remove(path.c_str());
+	}
+
+	// ==================================================
+	// every instance on the same file sees the same windows, also as a handler backend
+
+	{
+		std::string path = table_path("shared");
+		cli::SharedCooldowns first(path);
+		cli::SharedCooldowns second(path, 16);
+
+		CHECK(first(std::string_view("deploy"), seconds(60)));
+		CHECK(!second(std::string_view("deploy"), seconds(60)));
+
+		cli::CommandHandler handler;
+		int runs = 0;
+
+		handler.cmds["deploy"] = { {}, "limited", 60000, [&](cli::CommandHandler::Args) { runs++; } };
+		handler.cooldown_backend = std::ref(second);
+
+		cli::CommandHandler::Args args;
+		auto result = handler.run("deploy", args);
+
+		CHECK(!result.ok && std::string(result.message) == "command is on cooldown");
+		CHECK(runs == 0);
+
+		std::remove(path.c_str());
+	}
+
+	// ==================================================
+	// processes racing for the same key never get more than the limit between them
+
+	{
+		std::string path = table_path("processes");
+		const int processes = 8;
+		const int limit = 5;
+
+		std::vector<pid_t> children;
+
+		for (int p = 0; p < processes; p++)
+		{
+			pid_t pid = fork();
+
+			if (pid == 0)
+			{
+				cli::SharedCooldowns cooldowns(path, 64);
+				int granted = 0;
+
+				for (int i = 0; i < 200; i++)
+					granted += cooldowns.acquire("race", seconds(60), limit);
+
+				_exit(granted);
+			}
+
+			children.push_back(pid);
+		}
+
+		int total = 0;
+
+		for (pid_t pid : children)
+		{
+			int status = 0;
+			waitpid(pid, &status, 0);
+
+			if (WIFEXITED(status))
+				total += WEXITSTATUS(status);
+		}
+
+		CHECK(total == limit);
+
+		std::remove(path.c_str());
+	}
+
+	// ==================================================
+	// a full table of active keys fails open, expired slots are reused
+
+	{
+		std::string path = table_path("full");
+		cli::SharedCooldowns cooldowns(path, 4);
+
+		for (int i = 0; i < 4; i++)
+			CHECK(cooldowns.acquire("key " + std::to_string(i), milliseconds(100)));
+
+		CHECK(cooldowns.cleanup() == 0);
+
+		CHECK(cooldowns.acquire("new", milliseconds(100)));
+		CHECK(cooldowns.acquire("new", milliseconds(100)));
+
+		std::this_thread::sleep_for(milliseconds(150));
+
+		CHECK(cooldowns.cleanup() == 4);
+		CHECK(cooldowns.acquire("new", milliseconds(100)));
+		CHECK(!cooldowns.acquire("new", milliseconds(100)));
+
+		std::remove(path.c_str());
+	}
+
+	// ==================================================
+	// a slot a process died in the middle of reusing is taken over once it is stale, without spinning meanwhile
+
+	{
+		std::string path = table_path("crashed");
+
+		{
+			cli::SharedCooldowns cooldowns(path, 1);
+			CHECK(cooldowns.acquire("old", milliseconds(1)));
+		}
+
+		// the table starts after the 24 byte header, a slot is key, state, window. this is what a process leaves
+		// behind when it dies right after marking the slot
+		timespec ts{};
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+
+		uint64_t now = (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000 + 1;
+		uint64_t state = (now << 16) | 0xffff;
+
+		int fd = open(path.c_str(), O_RDWR);
+		CHECK(pwrite(fd, &state, sizeof(state), 24 + 8) == (ssize_t)sizeof(state));
+		close(fd);
+
+		cli::SharedCooldowns cooldowns(path);
+
+		auto wall = steady_clock::now();
+		clock_t cpu = clock();
+
+		CHECK(cooldowns.acquire("new", seconds(60)));
+
+		auto waited = steady_clock::now() - wall;
+		double cpu_seconds = (double)(clock() - cpu) / CLOCKS_PER_SEC;
+
+		CHECK(waited >= milliseconds(900) && waited < seconds(5));
+		CHECK(cpu_seconds < 0.25);
+		CHECK(!cooldowns.acquire("new", seconds(60)));
+
+		std::remove(path.c_str());
+	}
+
+	// ==================================================
+	// a slot that was just claimed and not used yet is not handed to another key, even with no window set
+
+	{
+		std::string path = table_path("claimed");
+
+		{
+			cli::SharedCooldowns cooldowns(path, 1);
+			CHECK(cooldowns.acquire("old", milliseconds(1)));
+		}
+
+		timespec ts{};
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+
+		uint64_t now = (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000 + 1;
+		uint64_t slot[2] = { now << 16, 0 };
+
+		// state and window of the only slot, as a process leaves them right after claiming it
+		int fd = open(path.c_str(), O_RDWR);
+		CHECK(pwrite(fd, slot, sizeof(slot), 24 + 8) == (ssize_t)sizeof(slot));
+		close(fd);
+
+		cli::SharedCooldowns cooldowns(path);
+
+		// the table is full so the new key fails open, and the slot still belongs to the old key
+		CHECK(cooldowns.acquire("new", seconds(60)));
+		CHECK(cooldowns.acquire("old", seconds(60)));
+		CHECK(!cooldowns.acquire("old", seconds(60)));
+
+		std::remove(path.c_str());
+	}
+
+	// ==================================================
+	// without a table everything is allowed
+
+	{
+		cli::SharedCooldowns cooldowns("/nonexistent/dir/table");
+
+		CHECK(!cooldowns.ok());
+		CHECK(cooldowns.acquire("x", seconds(60)));
+		CHECK(cooldowns.acquire("x", seconds(60)));
+		CHECK(cooldowns.cleanup() == 0);
+	}
+
+	return check::done("shared_cooldown");
+}
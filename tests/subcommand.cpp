@@ -0,0 +1,218 @@
+#include <sstream>
+#include "../cli-framework/pipe.hpp"
+#include "check.hpp"
+
+using Args = cli::CommandHandler::Args;
+
+int main()
+{
+	cli::CommandHandler handler;
+
+	bool verbose = false, fetch = false;
+	std::string name;
+	Args got;
+	std::string ran;
+
+	auto &remote = handler.cmds["remote"];
+
+	remote.alias = { "r" };
+	remote.description = "manages remotes";
+	remote.flags.set(verbose, "v", "verbose output");
+
+	auto &add = remote.sub().cmds["add"];
+
+	add.alias = { "a" };
+	add.description = "adds a remote";
+	add.cooldown = 60000;
+	add.exec = [&](Args args) { ran = "add"; got = args; };
+	add.flags.set(fetch, "f", "fetches after adding").set(name, "name", "name of the remote");
+
+	auto &show = remote.sub().cmds["show"];
+
+	show.description = "shows a remote";
+	show.write = [&](Args args, std::ostream& os) { os << "show " << args.size() << '\n'; };
+
+	handler.cmds["plain"] = { {}, "has no subcommands", 0, [&](Args args) { ran = "plain"; got = args; } };
+
+	bool upper = false;
+
+	auto &fmt = handler.cmds["fmt"];
+
+	fmt.description = "prints its arguments";
+	fmt.flags.set(upper, "u", "uppercase");
+	fmt.write = [&](Args args, std::ostream& os)
+	{
+		for (auto &arg : args)
+		{
+			for (char c : arg)
+				os << (upper ? (char)toupper((unsigned char)c) : c);
+		}
+
+		os << '\n';
+	};
+
+	auto reset = [&]
+	{
+		got.clear();
+		ran.clear();
+	};
+
+	// ==================================================
+	// the path is walked once, every flag goes to the innermost level that knows it
+
+	{
+		reset();
+
+		Args args = { "-v", "add", "-f", "-name", "up", "origin", "-x", "url" };
+
+		CHECK(handler.run("remote", args).ok);
+		CHECK(ran == "add");
+		CHECK(verbose && fetch && name == "up");
+		CHECK((got == Args{ "origin", "-x", "url" }));
+	}
+
+	// ==================================================
+	// flags go back to their defaults on the next run
+
+	{
+		reset();
+
+		Args args = { "show", "x" };
+		std::ostringstream os;
+
+		CHECK(handler.run("remote", args, os).ok);
+		CHECK(!verbose);
+
+		args = { "-u", "abc" };
+		CHECK(handler.run("fmt", args, os).ok);
+		CHECK(upper);
+
+		args = { "abc" };
+		CHECK(handler.run("fmt", args, os).ok);
+		CHECK(!upper);
+
+		CHECK(os.str() == "show 1\nABC\nabc\n");
+
+		// stages run at the same time, two of them can not bind the same flags
+		auto result = cli::pipeline(handler, Args{ "fmt", "-u", "a", "|", "fmt" }, os);
+		CHECK(!result.ok && std::string(result.message) == "command with flags used in more than one pipeline stage");
+	}
+
+	// ==================================================
+	// aliases on every level and a cooldown per path
+
+	{
+		reset();
+
+		Args args = { "a", "origin" };
+		std::string path;
+		cli::CommandHandler::Result result;
+
+		CHECK(handler.lookup("r", args, path, result) == &add);
+		CHECK(path == "remote add");
+
+		// add already ran above and is on cooldown, its sibling is not
+		args = { "a", "origin" };
+		result = handler.run("r", args);
+
+		CHECK(!result.ok && std::string(result.message) == "command is on cooldown");
+		CHECK(ran.empty());
+
+		Args show_args = { "show", "origin" };
+		std::ostringstream os;
+
+		CHECK(handler.run("remote", show_args, os).ok);
+		CHECK(os.str() == "show 1\n");
+	}
+
+	// ==================================================
+	// "--" ends flags and the path, words after the first positional are not subcommands
+
+	{
+		reset();
+
+		Args args = { "show", "--", "-v", "add" };
+		std::ostringstream os;
+
+		CHECK(handler.run("remote", args, os).ok);
+		CHECK(!verbose);
+		CHECK(os.str() == "show 2\n");
+		CHECK((args == Args{ "-v", "add" }));
+
+		args = { "show", "origin", "add" };
+		os.str("");
+
+		CHECK(handler.run("remote", args, os).ok);
+		CHECK(os.str() == "show 2\n");
+	}
+
+	// ==================================================
+	// a command that only has subcommands needs one, plain commands keep their arguments
+
+	{
+		reset();
+
+		Args args = { "-v" };
+		auto result = handler.run("remote", args);
+
+		CHECK(!result.ok && std::string(result.message) == "missing subcommand");
+
+		args = { "unknown" };
+		result = handler.run("remote", args);
+
+		CHECK(!result.ok && std::string(result.message) == "missing subcommand");
+
+		args = { "-v", "--", "x" };
+
+		CHECK(handler.run("plain", args).ok);
+		CHECK(ran == "plain");
+		CHECK((got == Args{ "-v", "--", "x" }));
+
+		args = {};
+		CHECK(!handler.run("missing", args).ok);
+	}
+
+	// ==================================================
+	// lookup reports the full path, help lists it and fan out takes it
+
+	{
+		Args args = { "show", "x" };
+		std::string path;
+		cli::CommandHandler::Result result;
+
+		CHECK(handler.lookup("r", args, path, result) == &show);
+		CHECK(path == "remote show");
+
+		std::ostringstream help;
+		handler.help(help);
+
+		CHECK(help.str() ==
+			"fmt: prints its arguments\n"
+			"plain: has no subcommands\n"
+			"remote: manages remotes\n"
+			"remote add: adds a remote\n"
+			"remote show: shows a remote\n");
+
+		std::ostringstream os;
+
+		CHECK(handler.fan_out("remote show a", std::vector<Args>{ {}, { "b" } }, os).ok);
+		CHECK(os.str() == "show 1\nshow 2\n");
+
+		CHECK(!handler.fan_out("remote", std::vector<Args>{ {} }, os).ok);
+	}
+
+	// ==================================================
+	// commands added after the first lookup are still found
+
+	{
+		handler.cmds["late"] = { { "l" }, "added later", 0, [&](Args) { ran = "late"; } };
+
+		Args args;
+
+		CHECK(handler.run("l", args).ok);
+		CHECK(ran == "late");
+		CHECK(handler.find("late") && !handler.find("nothing"));
+	}
+
+	return check::done("subcommand");
+}
@@ -0,0 +1,115 @@
+#include <string>
+#include <vector>
+#include "../cli-framework/tokenize.hpp"
+#include "check.hpp"
+
+using Words = std::vector<std::string>;
+
+static Words words(std::string_view line)
+{
+	cli::Tokens tokens = cli::tokenize(line);
+
+	CHECK(!tokens.error);
+
+	return tokens.args();
+}
+
+static const char* error(std::string_view line)
+{
+	return cli::tokenize(line).error;
+}
+
+int main()
+{
+	// ==================================================
+	// blanks, quotes and escapes
+
+	CHECK(words("") == Words{});
+	CHECK(words("  \t\n ") == Words{});
+	CHECK((words(" say  hello\tworld\n") == Words{ "say", "hello", "world" }));
+	CHECK((words("say 'hello world' \"it's\"") == Words{ "say", "hello world", "it's" }));
+	CHECK((words("a'b'\"c\"d") == Words{ "abcd" }));
+	CHECK((words("it\\'s a\\ b \\\\") == Words{ "it's", "a b", "\\" }));
+	CHECK((words("'\\n $x \"'") == Words{ "\\n $x \"" }));
+	CHECK((words("\"\\$ \\` \\\" \\\\ \\n\"") == Words{ "$ ` \" \\ \\n" }));
+
+	// '' and "" are empty words, a continuation alone is nothing
+	CHECK((words("a '' \"\" b") == Words{ "a", "", "", "b" }));
+	CHECK((words("foo \\\n bar") == Words{ "foo", "bar" }));
+	CHECK((words("fo\\\no \"b\\\nar\"") == Words{ "foo", "bar" }));
+	CHECK(words("\\\n") == Words{});
+
+	// ==================================================
+	// comments only start a word
+
+	CHECK((words("a # b c") == Words{ "a" }));
+	CHECK((words("a#b '#c'") == Words{ "a#b", "#c" }));
+	CHECK((words("# all\nnext line") == Words{ "next", "line" }));
+
+	// ==================================================
+	// an unquoted | is an operator, with or without blanks around it
+
+	{
+		cli::Tokens tokens = cli::tokenize("seq 10|grep 1 | head");
+
+		CHECK((tokens.args() == Words{ "seq", "10", "|", "grep", "1", "|", "head" }));
+		CHECK((tokens.operators == std::vector<size_t>{ 2, 5 }));
+
+		tokens = cli::tokenize("grep \"|\" f | echo '|' a\\|b x'|'y");
+
+		CHECK((tokens.args() == Words{ "grep", "|", "f", "|", "echo", "|", "a|b", "x|y" }));
+		CHECK((tokens.operators == std::vector<size_t>{ 3 }));
+
+		tokens = cli::tokenize("a'b'|c");
+
+		CHECK((tokens.args() == Words{ "ab", "|", "c" }));
+		CHECK((tokens.operators == std::vector<size_t>{ 1 }));
+	}
+
+	// ==================================================
+	// errors keep the words before them
+
+	{
+		cli::Tokens tokens = cli::tokenize("a b 'c");
+
+		CHECK(std::string(tokens.error) == "unterminated single quote");
+		CHECK((tokens.args() == Words{ "a", "b" }));
+
+		CHECK(std::string(error("a \"b")) == "unterminated double quote");
+		CHECK(std::string(error("a \"b\\")) == "unterminated double quote");
+		CHECK(std::string(error("a \\")) == "trailing backslash");
+	}
+
+	// ==================================================
+	// plain words are views into the line, joined words survive moving the tokens
+
+	{
+		std::string line = "plain 'quoted' jo'in'ed";
+		cli::Tokens tokens = cli::tokenize(line);
+
+		CHECK(tokens[0].data() == line.data());
+		CHECK(tokens[1].data() == line.data() + 7);
+
+		cli::Tokens moved = std::move(tokens);
+
+		CHECK(moved[2] == "joined");
+		CHECK(moved[2].data() < line.data() || moved[2].data() >= line.data() + line.size());
+	}
+
+	// ==================================================
+	// long lines put every special character at every offset of the 16 byte chunks
+
+	for (size_t offset = 0; offset < 40; offset++)
+	{
+		std::string pad(offset, 'x');
+
+		CHECK((words(pad + " 'a b'") == (offset ? Words{ pad, "a b" } : Words{ "a b" })));
+		CHECK((words(pad + "\"q\"") == Words{ pad + "q" }));
+		CHECK((words(pad + "\\ z") == Words{ pad + " z" }));
+		CHECK((words(pad + "|" + pad) == (offset ? Words{ pad, "|", pad } : Words{ "|" })));
+		CHECK((words(pad + "\t" + pad + "\n" + pad) == (offset ? Words{ pad, pad, pad } : Words{})));
+		CHECK((words("\"" + pad + "\\\"" + pad + "\"") == Words{ pad + "\"" + pad }));
+	}
+
+	return check::done("tokenize");
+}